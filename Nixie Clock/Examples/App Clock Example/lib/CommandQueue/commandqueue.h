@@ -0,0 +1,50 @@
+/**
+ @file commandqueue.h
+ @brief Wait-free single producer, single consumer queue of commands between two tasks
+ @author Edward62740
+ */
+
+#ifndef COMMANDQUEUE_H
+#define COMMANDQUEUE_H
+
+#include <stdint.h>
+#include <atomic>
+
+/**
+ @brief Called after every push, e.g. to wake the consumer task
+ @param [in] arg Argument given to setNotify()
+ */
+typedef void (*command_queue_notify_t)(void *arg);
+
+/**
+ @class CommandQueue
+ @brief Ring of N commands of type T, copied in by one producer task and out by one consumer task, on the same or
+        different cores. push() and pop() never block or loop, a full queue rejects the new command and counts it
+ @note The ring indexes are atomics with release/acquire ordering, so a popped command is always whole
+ */
+template <typename T, uint16_t N>
+class CommandQueue
+{
+    static_assert(N > 0 && (N & (N - 1)) == 0, "CommandQueue size must be a power of 2");
+
+    public:
+    CommandQueue();
+    void setNotify(command_queue_notify_t notify, void *arg);
+    bool push(const T &command);
+    bool pop(T &command);
+    uint16_t size();
+    uint32_t getOverflows();
+    uint16_t getHighWater();
+    private:
+    T _slots[N];
+    std::atomic<uint16_t> _head; // written by push(), free running
+    std::atomic<uint16_t> _tail; // written by pop(), free running
+    std::atomic<uint32_t> _overflows; // written by push()
+    std::atomic<uint16_t> _highWater; // written by push()
+    command_queue_notify_t _notify;
+    void *_notifyArg;
+};
+
+#include "commandqueue.tpp"
+
+#endif
@@ -0,0 +1,107 @@
+/**
+ @file commandqueue.tpp
+ @brief Wait-free single producer, single consumer queue of commands, template implementation included by commandqueue.h
+ @author Edward62740
+ */
+
+#ifndef COMMANDQUEUE_TPP
+#define COMMANDQUEUE_TPP
+
+template <typename T, uint16_t N>
+CommandQueue<T, N>::CommandQueue() : _head(0), _tail(0), _overflows(0), _highWater(0)
+{
+    _notify = NULL;
+    _notifyArg = NULL;
+}
+
+/**
+ @brief Sets the function called after every successful push()
+ @param [in] notify Function to call from the producer, e.g. one that calls xTaskNotifyGive() for the consumer, or NULL
+ @param [in] arg Argument passed to notify
+ @note Set it before the producer starts
+ */
+template <typename T, uint16_t N>
+void CommandQueue<T, N>::setNotify(command_queue_notify_t notify, void *arg)
+{
+    _notify = notify;
+    _notifyArg = arg;
+}
+
+/**
+ @brief Copies a command into the queue and notifies the consumer, producer side only
+ @param [in] command Command to queue
+ @return false if the queue was full, the command is dropped and counted by getOverflows()
+ */
+template <typename T, uint16_t N>
+bool CommandQueue<T, N>::push(const T &command)
+{
+    uint16_t head = _head.load(std::memory_order_relaxed);
+    uint16_t used = (uint16_t)(head - _tail.load(std::memory_order_acquire));
+    if (used >= N)
+    {
+        _overflows.store(_overflows.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return false;
+    }
+    _slots[head % N] = command;
+    _head.store((uint16_t)(head + 1), std::memory_order_release);
+    if (used + 1 > _highWater.load(std::memory_order_relaxed))
+    {
+        _highWater.store(used + 1, std::memory_order_relaxed);
+    }
+    if (_notify != NULL)
+    {
+        _notify(_notifyArg);
+    }
+    return true;
+}
+
+/**
+ @brief Copies the oldest command out of the queue, consumer side only
+ @param [out] command Oldest command, only valid if true is returned
+ @return false if the queue was empty
+ */
+template <typename T, uint16_t N>
+bool CommandQueue<T, N>::pop(T &command)
+{
+    uint16_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail == _head.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+    command = _slots[tail % N];
+    _tail.store((uint16_t)(tail + 1), std::memory_order_release);
+    return true;
+}
+
+/**
+ @brief Number of queued commands, may be stale by the time it returns
+ @return 0-N
+ */
+template <typename T, uint16_t N>
+uint16_t CommandQueue<T, N>::size()
+{
+    uint16_t tail = _tail.load(std::memory_order_acquire); // first, so the head read after it is never behind it
+    return (uint16_t)(_head.load(std::memory_order_acquire) - tail);
+}
+
+/**
+ @brief Number of commands dropped because the queue was full, i.e. the producer outpaced the consumer
+ @return Count since construction
+ */
+template <typename T, uint16_t N>
+uint32_t CommandQueue<T, N>::getOverflows()
+{
+    return _overflows.load(std::memory_order_relaxed);
+}
+
+/**
+ @brief Most commands the queue has held at once
+ @return 0-N, N means the queue has been full
+ */
+template <typename T, uint16_t N>
+uint16_t CommandQueue<T, N>::getHighWater()
+{
+    return _highWater.load(std::memory_order_relaxed);
+}
+
+#endif
@@ -0,0 +1,118 @@
+/**
+ @file host_stress.cpp
+ @brief Pushes numbered commands through CommandQueue from one thread to another and checks that every popped command
+        is whole and in order, and that the pushed, popped and overflowed counts add up. Then times push and pop
+ @note Build and run from this folder:
+       g++ -std=gnu++14 -O2 -pthread -I../.. host_stress.cpp -o host_stress && ./host_stress
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <thread>
+#include <chrono>
+#include "commandqueue.h"
+
+#define STRESS_COMMANDS 2000000
+#define BENCH_ROUNDS 10000000
+
+/* Same size as the commands of the clock, every field holds the sequence number so a torn copy shows */
+typedef struct StressCommand
+{
+    uint32_t seq;
+    uint32_t fields[3];
+} stress_command_t;
+
+static CommandQueue<stress_command_t, 8> queue;
+static uint32_t notifications = 0;
+
+static void countNotify(void *arg)
+{
+    (*(uint32_t *)arg)++;
+}
+
+/* The consumer pops until it sees the last command, slowed down every slowEvery pops to let the queue fill.
+   With retry the producer pushes again until a command fits, without it a full queue drops the command */
+static void runStress(const char *name, bool retry, uint32_t slowEvery)
+{
+    uint32_t overflowsBefore = queue.getOverflows();
+    uint32_t notifyBefore = notifications;
+    uint32_t popped = 0;
+    uint32_t torn = 0;
+    uint32_t disorder = 0;
+    std::thread consumer([&]() {
+        stress_command_t command;
+        uint32_t last = 0;
+        bool first = true;
+        while (true)
+        {
+            if (!queue.pop(command))
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            popped++;
+            if (command.fields[0] != command.seq || command.fields[1] != command.seq || command.fields[2] != command.seq)
+            {
+                torn++;
+            }
+            if (!first && command.seq <= last)
+            {
+                disorder++;
+            }
+            first = false;
+            last = command.seq;
+            if (command.seq == STRESS_COMMANDS)
+            {
+                break;
+            }
+            if (slowEvery && popped % slowEvery == 0)
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        }
+    });
+    uint32_t pushed = 0;
+    for (uint32_t seq = 1; seq <= STRESS_COMMANDS; seq++)
+    {
+        stress_command_t command = {seq, {seq, seq, seq}};
+        if (retry || seq == STRESS_COMMANDS)
+        {
+            while (!queue.push(command))
+            {
+                std::this_thread::yield();
+            }
+        }
+        else if (!queue.push(command))
+        {
+            continue;
+        }
+        pushed++;
+    }
+    consumer.join();
+    uint32_t overflows = queue.getOverflows() - overflowsBefore;
+    printf("%-26s %8u pushed %8u popped %8u overflows %u torn %u out of order, %s\n", name, (unsigned)pushed, (unsigned)popped,
+           (unsigned)overflows, (unsigned)torn, (unsigned)disorder,
+           popped == pushed && notifications - notifyBefore == pushed ? "counts add up" : "COUNTS DO NOT ADD UP");
+}
+
+int main()
+{
+    queue.setNotify(countNotify, &notifications);
+    runStress("producer retrying", true, 0);
+    runStress("producer dropping", false, 0);
+    runStress("consumer stalling", false, 64);
+    printf("high water %u of 8\n", (unsigned)queue.getHighWater());
+
+    /* Uncontended push and pop on one thread */
+    stress_command_t command = {0, {0, 0, 0}};
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < BENCH_ROUNDS; i++)
+    {
+        command.seq = i;
+        queue.push(command);
+        queue.pop(command);
+    }
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    printf("%.1f ns per push and pop, last %u\n", (double)ns / BENCH_ROUNDS, (unsigned)command.seq);
+    return 0;
+}
@@ -0,0 +1,144 @@
+/**
+ @file countdowntimer.cpp
+ @brief Countdown and stopwatch engine kept in milliseconds and stepped by the second edges of the clock
+ @author Edward62740
+ */
+
+#include "countdowntimer.h"
+
+CountdownTimer::CountdownTimer()
+{
+    _ms = 0;
+    _direction = COUNTDOWN_DOWN;
+    _running = false;
+    _expired = false;
+    _hook = NULL;
+    _hookArg = NULL;
+}
+
+/**
+ @brief Sets the function called when the timer expires
+ @param [in] hook Function called from tick(), in the task that ticks the timer, or NULL
+ @param [in] arg Argument passed to hook
+ */
+void CountdownTimer::setExpiredHook(countdown_event_t hook, void *arg)
+{
+    _hook = hook;
+    _hookArg = arg;
+}
+
+/**
+ @brief Starts counting, the time at the start is shown until the first tick()
+ @param [in] ms Time to count down from, or to start the stopwatch at, limited to COUNTDOWN_MAX_MS
+ @param [in] direction COUNTDOWN_DOWN or COUNTDOWN_UP
+ @note A countdown from 0 expires at the first tick()
+ */
+void CountdownTimer::start(uint32_t ms, countdown_direction_t direction)
+{
+    _ms = ms > COUNTDOWN_MAX_MS ? COUNTDOWN_MAX_MS : ms;
+    _direction = direction;
+    _running = true;
+    _expired = false;
+}
+
+/**
+ @brief Stops counting, the time is kept and no expiry is raised
+ */
+void CountdownTimer::stop()
+{
+    _running = false;
+}
+
+/**
+ @brief Advances the timer, call it at every second edge of the clock
+ @param [in] ms Time since the last tick
+ @return true if the timer expired at this tick, the expired hook has been called then
+ */
+bool CountdownTimer::tick(uint32_t ms)
+{
+    if (!_running)
+    {
+        return false;
+    }
+    _ms = getMillis(ms);
+    if (_ms == (_direction == COUNTDOWN_DOWN ? 0 : COUNTDOWN_MAX_MS))
+    {
+        _running = false;
+        _expired = true;
+        if (_hook != NULL)
+        {
+            _hook(_hookArg);
+        }
+        return true;
+    }
+    return false;
+}
+
+/**
+ @brief Checks if the timer is counting
+ @return false before start(), after stop() and once expired
+ */
+bool CountdownTimer::isRunning()
+{
+    return _running;
+}
+
+/**
+ @brief Checks if the timer has run out since the last start()
+ @return true once expired
+ */
+bool CountdownTimer::isExpired()
+{
+    return _expired;
+}
+
+/**
+ @brief Direction given to the last start()
+ @return COUNTDOWN_DOWN or COUNTDOWN_UP
+ */
+countdown_direction_t CountdownTimer::getDirection()
+{
+    return _direction;
+}
+
+/**
+ @brief Remaining time of a countdown, elapsed time of a stopwatch
+ @param [in] ahead Time still to be ticked, e.g. COUNTDOWN_SECOND_MS for the time after the next tick
+ @return Time in ms, 0-COUNTDOWN_MAX_MS
+ */
+uint32_t CountdownTimer::getMillis(uint32_t ahead)
+{
+    if (!_running)
+    {
+        return _ms;
+    }
+    if (_direction == COUNTDOWN_DOWN)
+    {
+        return _ms > ahead ? _ms - ahead : 0;
+    }
+    return COUNTDOWN_MAX_MS - _ms > ahead ? _ms + ahead : COUNTDOWN_MAX_MS;
+}
+
+/**
+ @brief Time for the display
+ @param [in] ahead Time still to be ticked, e.g. COUNTDOWN_SECOND_MS to stage the next second
+ @return HHMMSS, a countdown rounds part seconds up so 000000 only shows once it has expired, a stopwatch rounds down
+ */
+uint32_t CountdownTimer::hhmmss(uint32_t ahead)
+{
+    uint32_t ms = getMillis(ahead);
+    uint32_t sec = (_direction == COUNTDOWN_DOWN ? ms + COUNTDOWN_SECOND_MS - 1 : ms) / COUNTDOWN_SECOND_MS;
+    return sec / 3600 * 10000 + sec / 60 % 60 * 100 + sec % 60;
+}
+
+/**
+ @brief Converts a time as sent by the app to ms
+ @param [in] hour 0-99
+ @param [in] min 0-59
+ @param [in] sec 0-59
+ @return Time in ms
+ */
+uint32_t CountdownTimer::toMillis(uint8_t hour, uint8_t min, uint8_t sec)
+{
+    return (hour * 3600UL + min * 60UL + sec) * COUNTDOWN_SECOND_MS;
+}
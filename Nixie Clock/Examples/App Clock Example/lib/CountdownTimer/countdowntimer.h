@@ -0,0 +1,56 @@
+/**
+ @file countdowntimer.h
+ @brief Countdown and stopwatch engine kept in milliseconds and stepped by the second edges of the clock
+ @author Edward62740
+ */
+
+#ifndef COUNTDOWNTIMER_H
+#define COUNTDOWNTIMER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define COUNTDOWN_SECOND_MS 1000UL
+#define COUNTDOWN_MAX_MS (359999UL * COUNTDOWN_SECOND_MS) // 99:59:59, the most 6 tubes show
+
+typedef enum countdown_directions
+{
+    COUNTDOWN_DOWN, // counts down to 00:00:00 and expires there
+    COUNTDOWN_UP // stopwatch, counts up and expires at 99:59:59
+} countdown_direction_t;
+
+/**
+ @brief Called once when the timer expires, e.g. to flash the LEDs or sound a chime
+ @param [in] arg Argument given to setExpiredHook()
+ */
+typedef void (*countdown_event_t)(void *arg);
+
+/**
+ @class CountdownTimer
+ @brief Holds the remaining (or elapsed) time as milliseconds and derives the HHMMSS digits from it arithmetically.
+        tick() is called at every second edge of the clock, so the timer runs off the RTC and needs no timer of its own
+ */
+class CountdownTimer
+{
+    public:
+    CountdownTimer();
+    void setExpiredHook(countdown_event_t hook, void *arg);
+    void start(uint32_t ms, countdown_direction_t direction = COUNTDOWN_DOWN);
+    void stop();
+    bool tick(uint32_t ms = COUNTDOWN_SECOND_MS);
+    bool isRunning();
+    bool isExpired();
+    countdown_direction_t getDirection();
+    uint32_t getMillis(uint32_t ahead = 0);
+    uint32_t hhmmss(uint32_t ahead = 0);
+    static uint32_t toMillis(uint8_t hour, uint8_t min, uint8_t sec);
+    private:
+    uint32_t _ms; // remaining time counting down, elapsed time counting up
+    countdown_direction_t _direction;
+    bool _running;
+    bool _expired;
+    countdown_event_t _hook;
+    void *_hookArg;
+};
+
+#endif
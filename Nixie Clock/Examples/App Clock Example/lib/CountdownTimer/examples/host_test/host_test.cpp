@@ -0,0 +1,147 @@
+/**
+ @file host_test.cpp
+ @brief Runs CountdownTimer through one million simulated second edges and checks every displayed time, the staged
+        next second and the expiry event against hours, minutes and seconds counted with borrow and carry
+ @note Build and run from this folder:
+       g++ -std=gnu++14 -O2 -I../.. host_test.cpp ../../countdowntimer.cpp -o host_test && ./host_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "countdowntimer.h"
+
+#define TEST_SECONDS 1000000UL
+
+static CountdownTimer timer;
+static uint32_t expiries = 0;
+static uint32_t ticks = 0;
+static uint32_t mismatches = 0;
+static uint32_t eventErrors = 0;
+
+static void countExpiry(void *arg)
+{
+    (*(uint32_t *)arg)++;
+}
+
+/* Reference time, stepped the way the clock used to do it */
+typedef struct HMS
+{
+    int hour;
+    int min;
+    int sec;
+} hms_t;
+
+static uint32_t concat(const hms_t &t)
+{
+    return t.hour * 10000 + t.min * 100 + t.sec;
+}
+
+static bool stepDown(hms_t &t)
+{
+    if (t.sec > 0)
+    {
+        t.sec--;
+    }
+    else if (t.min > 0)
+    {
+        t.min--;
+        t.sec = 59;
+    }
+    else if (t.hour > 0)
+    {
+        t.hour--;
+        t.min = 59;
+        t.sec = 59;
+    }
+    return t.hour == 0 && t.min == 0 && t.sec == 0;
+}
+
+static bool stepUp(hms_t &t)
+{
+    if (++t.sec == 60)
+    {
+        t.sec = 0;
+        if (++t.min == 60)
+        {
+            t.min = 0;
+            t.hour++;
+        }
+    }
+    return t.hour == 99 && t.min == 59 && t.sec == 59;
+}
+
+/* Runs one countdown or stopwatch from start until it expires or the seconds budget runs out */
+static void run(hms_t t, countdown_direction_t direction)
+{
+    timer.start(CountdownTimer::toMillis(t.hour, t.min, t.sec), direction);
+    if (timer.hhmmss() != concat(t))
+    {
+        mismatches++;
+    }
+    bool expired = false;
+    while (!expired && ticks < TEST_SECONDS)
+    {
+        uint32_t staged = timer.hhmmss(COUNTDOWN_SECOND_MS);
+        uint32_t before = expiries;
+        bool event = timer.tick();
+        ticks++;
+        expired = direction == COUNTDOWN_DOWN ? stepDown(t) : stepUp(t);
+        if (timer.hhmmss() != concat(t) || staged != concat(t))
+        {
+            mismatches++;
+        }
+        if (event != expired || expiries - before != (expired ? 1U : 0U) || timer.isRunning() == expired)
+        {
+            eventErrors++;
+        }
+    }
+    if (expired)
+    {
+        /* Further edges leave an expired timer where it stopped and raise nothing */
+        uint32_t shown = timer.hhmmss();
+        if (timer.tick() || timer.hhmmss() != shown || !timer.isExpired())
+        {
+            eventErrors++;
+        }
+    }
+}
+
+int main()
+{
+    timer.setExpiredHook(countExpiry, &expiries);
+    srand(1);
+    uint32_t runs = 0;
+    run({99, 59, 59}, COUNTDOWN_DOWN);
+    run({0, 0, 0}, COUNTDOWN_UP);
+    runs += 2;
+    while (ticks < TEST_SECONDS)
+    {
+        hms_t t = {rand() % 3, rand() % 60, rand() % 60};
+        if (runs % 7 == 0)
+        {
+            t.hour = 99 - t.hour; // stopwatches close to the limit
+            run(t, COUNTDOWN_UP);
+        }
+        else
+        {
+            run(t, COUNTDOWN_DOWN);
+        }
+        runs++;
+    }
+    printf("%u runs, %u second edges, %u expiries, %u wrong times, %u wrong events\n", (unsigned)runs, (unsigned)ticks,
+           (unsigned)expiries, (unsigned)mismatches, (unsigned)eventErrors);
+
+    /* Cost of one second edge: tick, the time to show and the next second to stage */
+    clock_t start = clock();
+    uint32_t sum = 0;
+    timer.start(COUNTDOWN_MAX_MS);
+    for (uint32_t i = 0; i < TEST_SECONDS; i++)
+    {
+        timer.tick();
+        sum += timer.hhmmss() + timer.hhmmss(COUNTDOWN_SECOND_MS);
+    }
+    double ns = (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / TEST_SECONDS;
+    printf("%.1f ns per second edge (%u)\n", ns, (unsigned)(sum & 0xFF));
+    return mismatches || eventErrors ? 1 : 0;
+}
@@ -27,6 +27,8 @@
 #define PCA9698_CONFIG_PORT2 0x1A
 #define PCA9698_CONFIG_PORT3 0x1B
 #define PCA9698_CONFIG_PORT4 0x1C
+#define PCA9698_AUTO_INCREMENT 0x80
+#define PCA9698_PORT_COUNT 5
 
 /**
  @class PCA9698
@@ -40,14 +42,15 @@ class PCA9698 {
     int digitalRead(uint8_t pin);
     void setAllClear();
     void portMode(uint8_t port, uint8_t mode);
+    bool writePorts(uint8_t port, const uint8_t * data, uint8_t num);
+    void writeAllPorts(const uint8_t data[PCA9698_PORT_COUNT]);
+    void readAllPorts(uint8_t data[PCA9698_PORT_COUNT]);
+    void setPortModes(const uint8_t modes[PCA9698_PORT_COUNT]);
   private:
     uint8_t _i2caddr;
-    uint8_t _output_port0;
-    uint8_t _output_port1;
-    uint8_t _output_port2;
-    uint8_t _output_port3;
-    uint8_t _output_port4;
+    uint8_t _output_port[PCA9698_PORT_COUNT];
     void writeI2c(uint8_t address, uint8_t data);
+    uint8_t writeI2c(uint8_t address, const uint8_t * data, uint8_t num);
     void readI2c(uint8_t address, uint8_t num, uint8_t * data);
 };
 
@@ -0,0 +1,342 @@
+/**
+ @file host_benchmark.cpp
+ @brief Runs NixieDisplay on LinuxNixiePlatform and reports expander writes and simulated latency per update.
+        Checks the expander writes, cathode edges and latency against their budgets, the shape of the crossfade trace
+        and the cathodes left on, and exits with 1 on a failure
+ @note Build and run from this folder:
+       g++ -std=gnu++14 -I../.. host_benchmark.cpp -o host_benchmark && ./host_benchmark
+ */
+
+#include <stdio.h>
+#include "nixiedisplay.h"
+#include "nixieplatform_linux.h"
+
+/* Nixie tube pinouts (HW Version 2) */
+static constexpr uint8_t pinouts[6][10] = {
+    {5, 4, 3, 2, 1, 0, 9, 8, 7, 6},
+    {15, 14, 13, 12, 11, 10, 27, 26, 25, 24},
+    {35, 34, 31, 30, 29, 28, 39, 38, 37, 36},
+    {45, 44, 43, 42, 41, 40, 49, 48, 47, 46},
+    {55, 54, 53, 52, 51, 50, 67, 66, 65, 64},
+    {75, 74, 71, 70, 69, 68, 79, 78, 77, 76}};
+
+/* 4 tube status panel on its own expander, run alongside the clock */
+static constexpr uint8_t panelPinouts[4][10] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9},
+    {10, 11, 12, 13, 14, 15, 16, 17, 18, 19},
+    {20, 21, 22, 23, 24, 25, 26, 27, 28, 29},
+    {30, 31, 32, 33, 34, 35, 36, 37, 38, 39}};
+
+static_assert(nixiePinoutsUnique(pinouts) && nixiePinoutsUnique(panelPinouts), "cathodes collide");
+
+static LinuxNixiePlatform platform;
+static NixieDisplay<6> display(platform, 6, 0, nixieRoutes(pinouts));
+static LinuxNixiePlatform panelPlatform;
+static NixieDisplay<4> panel(panelPlatform, 4, 0, nixieRoutes(panelPinouts));
+
+static uint32_t failures = 0;
+
+static void expect(const char *name, bool ok, const char *what)
+{
+    if (!ok)
+    {
+        printf("FAIL %s: %s\n", name, what);
+        failures++;
+    }
+}
+
+/* Cathodes of the clock that differ from the digits of num */
+static uint32_t wrongCathodes(uint32_t num)
+{
+    uint8_t digits[6];
+    uint32_t wrong = 0;
+    NixieDigits<6>::split(num, digits);
+    for (uint8_t n = 0; n < 6; n++)
+    {
+        for (uint8_t d = 0; d < 10; d++)
+        {
+            if (platform.pin(pinouts[n][d]) != (d == digits[n]))
+            {
+                wrong++;
+            }
+        }
+    }
+    return wrong;
+}
+
+/* The transitions of all tubes that change start at the write and run side by side, so the trace ends one transition
+   period after the write however many tubes change, and the written number is left on */
+static void checkTransition(const char *name, uint32_t start, uint32_t num, uint32_t maxMs)
+{
+    bool seen[6] = {false};
+    bool late = false;
+    uint32_t end = start;
+    for (size_t i = 0; i < platform.trace().size(); i++)
+    {
+        const nixie_gpio_event_t &event = platform.trace()[i];
+        for (uint8_t n = 0; n < 6; n++)
+        {
+            for (uint8_t d = 0; d < 10; d++)
+            {
+                if (pinouts[n][d] == event.pin && !seen[n])
+                {
+                    seen[n] = true;
+                    late |= event.ms != start;
+                }
+            }
+        }
+        end = event.ms > end ? event.ms : end;
+    }
+    expect(name, !late, "a tube started its transition after the write");
+    expect(name, end - start <= maxMs, "the last cathode edge is late");
+    expect(name, platform.millis() - start <= maxMs, "latency over budget");
+    expect(name, wrongCathodes(num) == 0, "wrong cathodes after the transition");
+}
+
+/* Expander writes are the I2C transactions of the update, one burst per chip and commit at most */
+static void checkWrites(const char *name, uint32_t maxWrites, uint32_t maxEdges)
+{
+    expect(name, platform.writes() <= maxWrites, "expander writes over budget");
+    expect(name, platform.trace().size() <= maxEdges, "cathode edges over budget");
+}
+
+static void report(const char *name, uint32_t start)
+{
+    printf("%-34s %6u writes %6u edges %7u ms\n", name, (unsigned)platform.writes(),
+           (unsigned)platform.trace().size(), (unsigned)(platform.millis() - start));
+}
+
+static void benchWrite(const char *name, uint32_t from, uint32_t to, uint32_t maxWrites, uint32_t maxEdges, uint32_t maxMs)
+{
+    display.write(from);
+    display.flush();
+    platform.reset();
+    uint32_t start = platform.millis();
+    display.write(to);
+    display.flush(); // services the transitions every 1ms of virtual time
+    report(name, start);
+    checkWrites(name, maxWrites, maxEdges);
+    checkTransition(name, start, to, maxMs);
+}
+
+static void benchWriteTime(const char *name, int hour, int min, int sec, uint32_t maxWrites, uint32_t maxEdges, uint32_t maxMs)
+{
+    struct tm time;
+    time.tm_hour = hour;
+    time.tm_min = min;
+    time.tm_sec = sec;
+    platform.reset();
+    uint32_t start = platform.millis();
+    display.writeTime(&time);
+    display.flush();
+    report(name, start);
+    checkWrites(name, maxWrites, maxEdges);
+    checkTransition(name, start, hour * 10000 + min * 100 + sec, maxMs);
+}
+
+/* Same as benchWrite, but sleeps for getServiceDelay() between services instead of servicing every 1ms */
+static void benchServiceDelay(const char *name, uint32_t from, uint32_t to, uint32_t maxWrites, uint32_t maxEdges, uint32_t maxMs)
+{
+    display.write(from);
+    display.flush();
+    platform.reset();
+    uint32_t start = platform.millis();
+    uint32_t services = 0;
+    display.write(to);
+    uint32_t delay = display.getServiceDelay();
+    while (delay != NIXIE_SERVICE_IDLE)
+    {
+        platform.delayMs(delay);
+        display.service();
+        services++;
+        delay = display.getServiceDelay();
+    }
+    printf("%-34s %6u writes %6u edges %7u ms, %u services\n", name, (unsigned)platform.writes(),
+           (unsigned)platform.trace().size(), (unsigned)(platform.millis() - start), (unsigned)services);
+    checkWrites(name, maxWrites, maxEdges);
+    checkTransition(name, start, to, maxMs);
+}
+
+static void benchProtection(const char *name, nixie_display_protection_t type, uint32_t ms, uint32_t maxWrites, uint32_t maxEdges)
+{
+    display.write(123456);
+    display.flush();
+    platform.reset();
+    uint32_t start = platform.millis();
+    display.runProtection(type, ms);
+    report(name, start);
+    checkWrites(name, maxWrites, maxEdges);
+}
+
+static void benchBackgroundProtection(const char *name, nixie_display_protection_t type, uint32_t ms, uint32_t maxWrites,
+                                      uint32_t maxEdges)
+{
+    uint32_t num = 123456;
+    uint32_t seconds = 0;
+    uint32_t misses = 0;
+    display.write(num);
+    display.flush();
+    platform.reset();
+    uint32_t start = platform.millis();
+    display.startProtection(type, ms);
+    while (display.isProtecting())
+    {
+        /* Clock ticks every second and services the display every 1ms in between */
+        display.write(++num);
+        for (uint32_t t = 0; t < 1000; t++)
+        {
+            display.service();
+            platform.delayMs(1);
+        }
+        /* The written time has to be back on the tubes by the next second edge */
+        misses += wrongCathodes(num);
+        seconds++;
+    }
+    printf("%-34s %6u writes %6u edges %7u ms, %u seconds, %u wrong cathodes at second edges\n", name, (unsigned)platform.writes(),
+           (unsigned)platform.trace().size(), (unsigned)(platform.millis() - start), (unsigned)seconds, (unsigned)misses);
+    checkWrites(name, maxWrites, maxEdges);
+    expect(name, misses == 0, "wrong cathodes at second edges");
+}
+
+/* Tube-ms spent lighting cathodes other than the written digit, i.e. time the tubes were not showing the clock */
+static uint64_t protectionTubeMs(uint64_t before[6][10], const uint8_t digits[6])
+{
+    uint64_t total = 0;
+    for (uint8_t n = 0; n < 6; n++)
+    {
+        for (uint8_t d = 0; d < 10; d++)
+        {
+            if (d != digits[n])
+            {
+                total += display.getCathodeUsage(n + 1, d) - before[n][d];
+            }
+        }
+    }
+    return total;
+}
+
+static void benchWeightedProtection(const char *name, nixie_display_protection_t type, uint32_t ms, uint32_t maxWrites,
+                                    uint32_t maxEdges)
+{
+    /* 10 minutes of clock from 12:34:00, then one protection run */
+    struct tm time;
+    time.tm_hour = 12;
+    time.tm_min = 34;
+    time.tm_sec = 0;
+    display.writeTime(&time);
+    display.flush();
+    display.runProtection(CATHODE_PROTECTION_STYLE_WEIGHTED, 100000); // use up the on-time since the last run
+    for (uint32_t s = 0; s < 600; s++)
+    {
+        time.tm_sec = (34 * 60 + s) % 60;
+        time.tm_min = (34 * 60 + s) / 60;
+        uint32_t tick = platform.millis();
+        display.writeTime(&time);
+        display.flush();
+        platform.delayMs(1000 - (platform.millis() - tick));
+    }
+    uint64_t before[6][10];
+    for (uint8_t n = 0; n < 6; n++)
+    {
+        for (uint8_t d = 0; d < 10; d++)
+        {
+            before[n][d] = display.getCathodeUsage(n + 1, d);
+        }
+    }
+    const uint8_t digits[6] = {1, 2, 4, 3, 5, 9};
+    platform.reset();
+    uint32_t start = platform.millis();
+    display.runProtection(type, ms);
+    printf("%-34s %6u writes %6u edges %7u ms, %u tube-ms off the clock\n", name, (unsigned)platform.writes(),
+           (unsigned)platform.trace().size(), (unsigned)(platform.millis() - start), (unsigned)protectionTubeMs(before, digits));
+    checkWrites(name, maxWrites, maxEdges);
+}
+
+static void benchPlay(const char *name, const nixie_sequence_t &sequence, uint32_t period, uint32_t maxWrites, uint32_t maxEdges)
+{
+    uint32_t expected = 0;
+    for (uint16_t i = 0; i < sequence.length; i++)
+    {
+        expected += sequence.frames[i].dwell ? sequence.frames[i].dwell : 15;
+    }
+    display.write(123456);
+    display.flush();
+    platform.reset();
+    uint32_t start = platform.millis();
+    display.play(sequence);
+    while (display.isPlaying())
+    {
+        display.service();
+        platform.delayMs(period);
+    }
+    printf("%-34s %6u writes %6u edges %7u ms, %u ms of frames, serviced every %u ms\n", name, (unsigned)platform.writes(),
+           (unsigned)platform.trace().size(), (unsigned)(platform.millis() - start), (unsigned)expected, (unsigned)period);
+    checkWrites(name, maxWrites, maxEdges);
+}
+
+int main()
+{
+    display.init();
+    display.flush();
+
+    printf("%-34s %13s %12s %10s\n", "update", "expander", "cathode", "latency");
+    /* One transition period, 140ms for a crossfade and 160ms with the scrollback of a 5 -> 0 tube, not one per tube */
+    benchWrite("write 123456 -> 123457", 123456, 123457, 15, 30, 140);
+    benchWrite("write 125959 -> 130000", 125959, 130000, 24, 86, 160);
+    benchServiceDelay("getServiceDelay 123456 -> 123457", 123456, 123457, 15, 30, 140);
+    benchServiceDelay("getServiceDelay 125959 -> 130000", 125959, 130000, 24, 86, 160);
+    display.setScrollback(false);
+    benchWrite("write 125959 -> 130000 (no scroll)", 125959, 130000, 30, 150, 140);
+    display.setCrossfade(false);
+    benchWrite("write 125959 -> 130000 (no fade)", 125959, 130000, 2, 10, 0);
+    display.setCrossfade(true);
+    display.setScrollback(true);
+
+    display.write(125959);
+    display.flush();
+    benchWriteTime("writeTime 12:59:59 -> 13:00:00", 13, 0, 0, 24, 86, 160);
+    benchWriteTime("writeTime 13:00:00 -> 13:00:01", 13, 0, 1, 15, 30, 140);
+
+    /* The second edge only costs the commit of a frame staged ahead of it */
+    display.write(125959);
+    display.flush();
+    display.stage(130000);
+    platform.reset();
+    display.commitStaged();
+    printf("%-34s %6u writes %6u edges\n", "commitStaged 125959 -> 130000", (unsigned)platform.writes(), (unsigned)platform.trace().size());
+    checkWrites("commitStaged 125959 -> 130000", 2, 10);
+    display.flush(); // the commit starts the transitions, the rest of them runs from service()
+    expect("commitStaged 125959 -> 130000", wrongCathodes(130000) == 0, "wrong cathodes after the transition");
+
+    benchProtection("runProtection WAVE 5s", CATHODE_PROTECTION_STYLE_WAVE, 5000, 660, 3960);
+    benchProtection("runProtection SLOT 5s", CATHODE_PROTECTION_STYLE_SLOT, 5000, 662, 3972);
+    benchProtection("runProtection SEQUENTIAL 5s", CATHODE_PROTECTION_STYLE_SEQUENTIAL, 5000, 662, 3968);
+    benchPlay("play SLOT_MACHINE", NIXIE_SEQUENCE_SLOT_MACHINE, 1, 60, 360);
+    benchPlay("play SLOT_MACHINE", NIXIE_SEQUENCE_SLOT_MACHINE, 7, 60, 360);
+    benchPlay("play ODOMETER", NIXIE_SEQUENCE_ODOMETER, 1, 26, 132);
+    benchPlay("play RIPPLE", NIXIE_SEQUENCE_RIPPLE, 1, 29, 132);
+
+    benchWeightedProtection("after 10min: SEQUENTIAL 5s", CATHODE_PROTECTION_STYLE_SEQUENTIAL, 5000, 662, 3970);
+    benchWeightedProtection("after 10min: WEIGHTED 5s", CATHODE_PROTECTION_STYLE_WEIGHTED, 5000, 431, 1988);
+    benchBackgroundProtection("startProtection SEQUENTIAL 5s", CATHODE_PROTECTION_STYLE_SEQUENTIAL, 5000, 814, 4324);
+    benchBackgroundProtection("startProtection SLOT 5s", CATHODE_PROTECTION_STYLE_SLOT, 5000, 814, 4352);
+
+    /* Two displays share nothing, writing the panel leaves the clock untouched */
+    display.write(123456);
+    display.flush();
+    panel.init();
+    panel.flush();
+    platform.reset();
+    panelPlatform.reset();
+    uint32_t start = panelPlatform.millis();
+    panel.write(4321);
+    panel.flush();
+    printf("%-34s %6u writes %6u edges %7u ms, clock %u writes\n", "panel write 9999 -> 4321", (unsigned)panelPlatform.writes(),
+           (unsigned)panelPlatform.trace().size(), (unsigned)(panelPlatform.millis() - start), (unsigned)platform.writes());
+    expect("panel write 9999 -> 4321", panelPlatform.writes() <= 15 && panelPlatform.trace().size() <= 120, "panel writes over budget");
+    expect("panel write 9999 -> 4321", platform.writes() == 0, "the panel wrote to the clock");
+    expect("panel write 9999 -> 4321", wrongCathodes(123456) == 0, "the clock lost its digits");
+
+    printf("%u failures\n", (unsigned)failures);
+    return failures ? 1 : 0;
+}
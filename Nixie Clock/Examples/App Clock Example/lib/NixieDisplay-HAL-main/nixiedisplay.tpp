@@ -0,0 +1,942 @@
+/**
+ @file nixiedisplay.tpp
+ @brief Library for interfacing with nixie tubes, template implementation included by nixiedisplay.h
+ @author Edward62740
+ */
+
+#ifndef NIXIEDISPLAY_TPP
+#define NIXIEDISPLAY_TPP
+
+/**
+ @brief Constructor for NixieDisplay
+ @param [in] platform GPIO sink and clock/delay source, must outlive the display
+ @param [in] active number of active tubes (max N)
+ @param [in] offset right shift
+ @param [in] routes Cathode routing table from nixieRoutes(), leftmost tube first
+ @return NixieDisplay object
+ */
+template <uint8_t N>
+NixieDisplay<N>::NixieDisplay(NixiePlatform &platform, uint8_t active, uint8_t offset, const NixieRouteTable<N> &routes)
+{
+    _platform = &platform;
+    _display.active = active > N ? N : active;
+    _display.offset = offset > N - _display.active ? N - _display.active : offset;
+
+    for (uint8_t j = 0; j < N; j++)
+    {
+        memcpy(_display.tube[j].route, routes.route[j], sizeof(_display.tube[j].route));
+        _display.digits[j] = 9;
+        _display.prev[j] = 9;
+        _display.tube[j].current = 9;
+        _display.tube[j].prev = 9;
+        _display.tube[j].lit = NIXIE_DIGIT_NONE;
+        _display.tube[j].transition = TRANSITION_NONE;
+        _display.tube[j].start = 0;
+        _display.tube[j].committed = NIXIE_DIGIT_NONE;
+        memset(_display.tube[j].usage, 0, sizeof(_display.tube[j].usage));
+        memset(_display.tube[j].recent, 0, sizeof(_display.tube[j].recent));
+        memset(_display.tube[j].plan, 0, sizeof(_display.tube[j].plan));
+    }
+    memset(_display.frame, 0, sizeof(_display.frame));
+    memset(_display.committed, 0, sizeof(_display.committed));
+    _display.synced = false;
+}
+
+/**
+ @brief Destructor for NixieDisplay
+ */
+template <uint8_t N>
+NixieDisplay<N>::~NixieDisplay(void)
+{
+    for (uint8_t j = 0; j < N; j++)
+    {
+        memset(_display.tube[j].route, 0, sizeof(_display.tube[j].route));
+    }
+}
+
+/**
+ @brief Initializes the NixieDisplay
+ @return NO_ERR if no error, else ERR_FAIL
+ */
+template <uint8_t N>
+nixie_display_err_t NixieDisplay<N>::init()
+{
+    nixie_display_err_t ret = NO_ERR;
+    ret = clear();
+    ret = write(9 * NixieDigits<N>::ones);
+    return ret;
+}
+
+/**
+ @brief Writes a number to the NixieDisplay
+ @param [in] num Number to be written to the NixieDisplay. Accepts a value from 0 to N nines, which is written left-justified
+ @return NO_ERR if no error, ERR_PARAM for invalid value, ERR_INT for internal function error
+ @note Returns as soon as the transitions are started, keep calling service() until isTransitioning() is false
+ */
+template <uint8_t N>
+nixie_display_err_t NixieDisplay<N>::write(uint32_t num)
+{
+    if (num > NixieDigits<N>::max)
+    {
+        return ERR_PARAM;
+    }
+    NixieDigits<N>::split(num, _display.digits);
+    return writeDigitsInternal(false);
+}
+
+/**
+ @brief Writes a time to the NixieDisplay
+ @param [in] *time Pointer to C tm structure
+ @return NO_ERR if no error, ERR_PARAM for invalid value, ERR_INT for internal function error
+ @note Writes HHMMSS to the 6 leftmost digits, only tubes whose digit changed are transitioned
+ */
+template <uint8_t N>
+nixie_display_err_t NixieDisplay<N>::writeTime(struct tm *time)
+{
+    static_assert(N >= 6, "writeTime() needs 6 tubes for HHMMSS");
+    if (time == nullptr)
+    {
+        return ERR_PARAM;
+    }
+    splitTimeInternal(time, _display.digits);
+    return writeDigitsInternal(true);
+}
+
+/**
+ @brief Prepares a number to be shown by the next commitStaged(), e.g. the next second ahead of the RTC interrupt
+ @param [in] num Number to be staged, same range as write()
+ @return NO_ERR if no error, ERR_PARAM for invalid value
+ @note Only the digits are computed here, nothing is sent to the expanders
+ */
+template <uint8_t N>
+nixie_display_err_t NixieDisplay<N>::stage(uint32_t num)
+{
+    nixie_display_err_t ret = NO_ERR;
+    if (num > NixieDigits<N>::max)
+    {
+        return ERR_PARAM;
+    }
+    NixieDigits<N>::split(num, _display.staged);
+    _display.ready = true;
+    return ret;
+}
+
+/**
+ @brief Prepares a time to be shown by the next commitStaged()
+ @param [in] *time Pointer to C tm structure
+ @return NO_ERR if no error, ERR_PARAM for invalid value
+ @note Stages HHMMSS in the 6 leftmost digits, like writeTime()
+ */
+template <uint8_t N>
+nixie_display_err_t NixieDisplay<N>::stageTime(struct tm *time)
+{
+    nixie_display_err_t ret = NO_ERR;
+    static_assert(N >= 6, "stageTime() needs 6 tubes for HHMMSS");
+    if (time == nullptr || time->tm_hour > 99 || time->tm_min > 59 || time->tm_sec > 60)
+    {
+        return ERR_PARAM;
+    }
+    memcpy(_display.staged, _display.digits, sizeof(_display.staged));
+    splitTimeInternal(time, _display.staged);
+    _display.ready = true;
+    return ret;
+}
+
+/**
+ @brief Shows the digits prepared by stage() or stageTime(). Starts the transitions of the changed tubes and commits
+        the first frame in one burst, so it is cheap enough to call straight from the second edge
+ @return NO_ERR if no error, ERR_PARAM if nothing is staged, ERR_INT for internal function error
+ */
+template <uint8_t N>
+nixie_display_err_t NixieDisplay<N>::commitStaged()
+{
+    if (!_display.ready)
+    {
+        return ERR_PARAM;
+    }
+    memcpy(_display.digits, _display.staged, sizeof(_display.digits));
+    _display.ready = false;
+    return writeDigitsInternal(true);
+}
+
+/**
+ @brief Internal function to split a time into HHMMSS digits
+ @param [in] *time Pointer to C tm structure
+ @param [out] digits[] Digits, the 6 leftmost are written
+ */
+template <uint8_t N>
+void NixieDisplay<N>::splitTimeInternal(struct tm *time, uint8_t digits[])
+{
+    digits[0] = time->tm_hour / 10;
+    digits[1] = time->tm_hour % 10;
+    digits[2] = time->tm_min / 10;
+    digits[3] = time->tm_min % 10;
+    digits[4] = time->tm_sec / 10;
+    digits[5] = time->tm_sec % 10;
+}
+
+/**
+ @brief Writes to a single tube
+ @param [in] tube Index from left of tube to be written, starting at 1
+ @param [in] value Integer to be written from 0-9
+ @return NO_ERR if no error, ERR_PARAM for invalid value, ERR_INT for internal function error
+ */
+template <uint8_t N>
+nixie_display_err_t NixieDisplay<N>::writeSingleTube(uint8_t tube, uint8_t value)
+{
+    nixie_display_err_t ret = NO_ERR;
+    if (value > 9 || tube < 1 || tube > _display.active)
+    {
+        return ERR_PARAM;
+    }
+    _display.digits[tube - 1] = (uint8_t)value;
+    if (writeTubeInternal(tube - 1, _display.digits[tube - 1 + _display.offset], _display.prev[tube - 1 + _display.offset]) != NO_ERR)
+    {
+        return ERR_INT;
+    }
+    memcpy(_display.prev, _display.digits, sizeof(_display.digits));
+    if (service() != NO_ERR)
+    {
+        return ERR_INT;
+    }
+    return ret;
+}
+
+/**
+ @brief Internal function to start the transitions from the previous to the current digits on all active tubes
+ @param [in] changed_only Only transition the tubes whose digit changed
+ @return NO_ERR if no error, ERR_INT for internal function error
+ */
+template <uint8_t N>
+nixie_display_err_t NixieDisplay<N>::writeDigitsInternal(bool changed_only)
+{
+    nixie_display_err_t ret = NO_ERR;
+    for (uint8_t n = 0; n < _display.active; n++)
+    {
+        uint8_t current = _display.digits[n + _display.offset];
+        uint8_t prev = _display.prev[n + _display.offset];
+        if (changed_only && current == prev)
+        {
+            continue;
+        }
+        if (writeTubeInternal(n, current, prev) != NO_ERR)
+        {
+            return ERR_INT;
+        }
+    }
+    memcpy(_display.prev, _display.digits, sizeof(_display.digits));
+    if (service() != NO_ERR)
+    {
+        return ERR_INT;
+    }
+    return ret;
+}
+
+/**
+ @brief Internal function to start the crossfade and scrollback effects on a tube
+ @param [in] tube Index from left of tube to be written
+ @param [in] current Integer to be displayed on tube
+ @param [in] prev Current integer on tube
+ @return NO_ERR if no error, ERR_PARAM for invalid value
+ @note The transition is only started here; it is driven by service(), so all tubes written in one call fade in parallel
+ */
+template <uint8_t N>
+nixie_display_err_t NixieDisplay<N>::writeTubeInternal(uint8_t tube, uint8_t current, uint8_t prev)
+{
+    nixie_display_err_t ret = NO_ERR;
+    if (current > 9 || prev > 9)
+    {
+        return ERR_PARAM;
+    }
+    TubeStruct_t *t = &_display.tube[tube];
+    t->current = current;
+    t->prev = prev;
+    t->start = _platform->millis();
+    if (current != prev)
+    {
+        _display.written = t->start;
+    }
+    if (_display.scrollback && current == 0 && prev != 0)
+    {
+        t->transition = TRANSITION_SCROLLBACK;
+    }
+    else if (_display.crossfade && !nixieRouteEqual(t->route[current], t->route[prev]))
+    {
+        t->transition = TRANSITION_CROSSFADE;
+    }
+    else
+    {
+        t->transition = TRANSITION_NONE;
+    }
+    return ret;
+}
+
+/**
+ @brief Internal function to advance the transition of a tube to the given time
+ @param [in] tube Index from left of tube to be serviced
+ @param [in] now Current time from NixiePlatform::millis()
+ */
+template <uint8_t N>
+void NixieDisplay<N>::serviceTubeInternal(uint8_t tube, uint32_t now)
+{
+    TubeStruct_t *t = &_display.tube[tube];
+    uint32_t elapsed = now - t->start;
+    uint8_t digit = t->current;
+    if (t->transition == TRANSITION_SCROLLBACK)
+    {
+        // prev is switched off straight away, then prev-1..1 are shown for one pulse cycle each
+        uint32_t step = elapsed / CROSSFADE_PULSE_CYCLE_MS;
+        if (step + 1 < t->prev)
+        {
+            digit = t->prev - 1 - step;
+        }
+        else
+        {
+            t->transition = TRANSITION_NONE;
+        }
+    }
+    else if (t->transition == TRANSITION_CROSSFADE)
+    {
+        // step k shows current for (0.2 + 0.1k) of the pulse cycle and prev for the rest, current leads so it lights on the first commit
+        uint32_t step = elapsed / CROSSFADE_PULSE_CYCLE_MS;
+        if (step < CROSSFADE_PULSE_STEPS)
+        {
+            uint32_t phase = elapsed % CROSSFADE_PULSE_CYCLE_MS;
+            if (phase >= (CROSSFADE_PULSE_CYCLE_MS * (2 + step)) / 10)
+            {
+                digit = t->prev;
+            }
+        }
+        else
+        {
+            t->transition = TRANSITION_NONE;
+        }
+    }
+    lightTubeInternal(tube, digit);
+}
+
+/**
+ @brief Internal function to switch a tube over to a digit in the desired cathode bitmap
+ @param [in] tube Index from left of tube to be written
+ @param [in] digit Digit to be lit, or NIXIE_DIGIT_NONE to blank the tube
+ @note Nothing is sent to the expanders until commit()
+ */
+template <uint8_t N>
+void NixieDisplay<N>::lightTubeInternal(uint8_t tube, uint8_t digit)
+{
+    TubeStruct_t *t = &_display.tube[tube];
+    if (t->lit == digit)
+    {
+        return;
+    }
+    if (t->lit != NIXIE_DIGIT_NONE)
+    {
+        setCathodeInternal(t->route[t->lit], 0);
+    }
+    if (digit != NIXIE_DIGIT_NONE)
+    {
+        setCathodeInternal(t->route[digit], 1);
+    }
+    t->lit = digit;
+}
+
+/**
+ @brief Internal function to set one cathode in the desired cathode bitmap
+ @param [in] route Expander, port and bit of the cathode
+ @param [in] data Cathode state
+ */
+template <uint8_t N>
+void NixieDisplay<N>::setCathodeInternal(const nixie_route_t &route, bool data)
+{
+    if (data)
+    {
+        _display.frame[route.chip][route.port] |= route.mask;
+    }
+    else
+    {
+        _display.frame[route.chip][route.port] &= (uint8_t)~route.mask;
+    }
+}
+
+/**
+ @brief Writes the desired cathode bitmap to the expanders
+ @return NO_ERR if no error, ERR_FAIL for failed write
+ @note Only the span of ports that changed since the last commit is sent, as one burst per expander.
+       The time since the last commit is added to the on-time of the cathodes that were lit
+ */
+template <uint8_t N>
+nixie_display_err_t NixieDisplay<N>::commit()
+{
+    nixie_display_err_t ret = NO_ERR;
+    countUsageInternal();
+    for (uint8_t chip = 0; chip < NIXIE_EXPANDER_COUNT(N); chip++)
+    {
+        uint8_t first = NIXIE_EXPANDER_PORTS;
+        uint8_t last = 0;
+        for (uint8_t port = 0; port < NIXIE_EXPANDER_PORTS; port++)
+        {
+            if (!_display.synced || _display.frame[chip][port] != _display.committed[chip][port])
+            {
+                if (first == NIXIE_EXPANDER_PORTS)
+                {
+                    first = port;
+                }
+                last = port;
+            }
+        }
+        if (first == NIXIE_EXPANDER_PORTS)
+        {
+            continue;
+        }
+        if (!_platform->portWrite(chip, first, &_display.frame[chip][first], last - first + 1))
+        {
+            ret = ERR_FAIL;
+            continue;
+        }
+        memcpy(&_display.committed[chip][first], &_display.frame[chip][first], last - first + 1);
+    }
+    if (ret == NO_ERR)
+    {
+        _display.synced = true;
+    }
+    return ret;
+}
+
+/**
+ @brief Internal function to add the time since the last commit to the on-time counters of the committed cathodes
+ */
+template <uint8_t N>
+void NixieDisplay<N>::countUsageInternal()
+{
+    uint32_t now = _platform->millis();
+    uint32_t elapsed = now - _display.counted;
+    for (uint8_t n = 0; n < _display.active; n++)
+    {
+        TubeStruct_t *t = &_display.tube[n];
+        if (t->committed != NIXIE_DIGIT_NONE)
+        {
+            t->usage[t->committed] += elapsed;
+            t->recent[t->committed] += elapsed;
+        }
+        t->committed = t->lit;
+    }
+    _display.counted = now;
+}
+
+/**
+ @brief Advances all running transitions, sequences and background protection, and commits the result. Call this often (every 1-2ms) while isTransitioning() or isPlaying() is true
+ @return NO_ERR if no error, ERR_FAIL for failed write
+ */
+template <uint8_t N>
+nixie_display_err_t NixieDisplay<N>::service()
+{
+    uint32_t now = _platform->millis();
+    if (_display.player.active)
+    {
+        servicePlayerInternal(now);
+    }
+    if (!_display.player.shown)
+    {
+        for (uint8_t n = 0; n < _display.active; n++)
+        {
+            serviceTubeInternal(n, now);
+        }
+    }
+    return commit();
+}
+
+/**
+ @brief Blocks until all running transitions have completed
+ @return NO_ERR if no error, ERR_FAIL for failed write
+ */
+template <uint8_t N>
+nixie_display_err_t NixieDisplay<N>::flush()
+{
+    nixie_display_err_t ret = service();
+    while (ret == NO_ERR && isTransitioning())
+    {
+        _platform->delayMs(1);
+        ret = service();
+    }
+    return ret;
+}
+
+/**
+ @brief Time until the next call to service() has something to change, so a caller can sleep in between
+ @return Delay in ms, 0 if service() is due now, NIXIE_SERVICE_IDLE if no transition or sequence is running
+ @note Crossfades change at every pulse edge, so this is a few ms while a tube is transitioning
+ */
+template <uint8_t N>
+uint32_t NixieDisplay<N>::getServiceDelay()
+{
+    uint32_t now = _platform->millis();
+    uint32_t delay = NIXIE_SERVICE_IDLE;
+    for (uint8_t n = 0; n < _display.active; n++)
+    {
+        TubeStruct_t *t = &_display.tube[n];
+        uint32_t phase = (now - t->start) % CROSSFADE_PULSE_CYCLE_MS;
+        uint32_t next = CROSSFADE_PULSE_CYCLE_MS - phase;
+        if (t->transition == TRANSITION_CROSSFADE)
+        {
+            uint32_t step = (now - t->start) / CROSSFADE_PULSE_CYCLE_MS;
+            uint32_t edge = (CROSSFADE_PULSE_CYCLE_MS * (2 + step)) / 10;
+            if (step >= CROSSFADE_PULSE_STEPS)
+            {
+                next = 0;
+            }
+            else if (phase < edge)
+            {
+                next = edge - phase;
+            }
+        }
+        if (t->transition != TRANSITION_NONE && next < delay)
+        {
+            delay = next;
+        }
+    }
+    PlayerStruct_t *p = &_display.player;
+    if (p->active && delay == NIXIE_SERVICE_IDLE)
+    {
+        uint32_t phase = (now - _display.written) % PROTECTION_WINDOW_PERIOD_MS;
+        if (p->windowed && phase < PROTECTION_WINDOW_START_MS)
+        {
+            delay = PROTECTION_WINDOW_START_MS - phase;
+        }
+        else if (p->windowed && phase >= PROTECTION_WINDOW_END_MS)
+        {
+            delay = PROTECTION_WINDOW_PERIOD_MS - phase + PROTECTION_WINDOW_START_MS;
+        }
+        else if (!p->shown || (int32_t)(p->next - now) <= 0)
+        {
+            delay = 0;
+        }
+        else
+        {
+            delay = p->next - now;
+            if (p->windowed && PROTECTION_WINDOW_END_MS - phase < delay)
+            {
+                delay = PROTECTION_WINDOW_END_MS - phase;
+            }
+        }
+    }
+    return delay;
+}
+
+/**
+ @brief Checks if any tube is still in a crossfade or scrollback
+ @return true if a transition is running
+ */
+template <uint8_t N>
+bool NixieDisplay<N>::isTransitioning()
+{
+    for (uint8_t n = 0; n < _display.active; n++)
+    {
+        if (_display.tube[n].transition != TRANSITION_NONE)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ @brief Clears all numbers from the NixieDisplay
+ @return NO_ERR if no error, ERR_FAIL for failed write
+ */
+template <uint8_t N>
+nixie_display_err_t NixieDisplay<N>::clear()
+{
+    nixie_display_err_t ret = NO_ERR;
+    for (uint8_t i = 0; i < _display.active; i++)
+    {
+        for (uint8_t j = 0; j < 10; j++)
+        {
+            setCathodeInternal(_display.tube[i].route[j], 0);
+        }
+        _display.tube[i].lit = NIXIE_DIGIT_NONE;
+        _display.tube[i].transition = TRANSITION_NONE;
+    }
+    ret = commit();
+    return ret;
+}
+
+/**
+ @brief Option to select crossfade effect
+ @param [in] crossfade
+ @return NO_ERR if no error
+ */
+template <uint8_t N>
+nixie_display_err_t NixieDisplay<N>::setCrossfade(bool crossfade)
+{
+    nixie_display_err_t ret = NO_ERR;
+    _display.crossfade = (bool)crossfade;
+    return ret;
+}
+
+/**
+ @brief Option to select scrollback effect
+ @param [in] crossfade
+ @return NO_ERR if no error
+ */
+template <uint8_t N>
+nixie_display_err_t NixieDisplay<N>::setScrollback(bool scrollback)
+{
+    nixie_display_err_t ret = NO_ERR;
+    _display.scrollback = (bool)scrollback;
+    return ret;
+}
+
+/**
+ @brief Runs cathode protection, blocking until it is done
+ @param [in] type Protection visual effect
+ @param [in] ms Time to run in ms
+ @param [in] CATHODE_PROTECTION_INTER_MS Time spent on each digit in ms, default is 15
+ @return NO_ERR if no error, ERR_PARAM if invalid parameters, ERR_INT for internal function error
+ @note Use startProtection() to keep the written digits up between frames
+ */
+template <uint8_t N>
+nixie_display_err_t NixieDisplay<N>::runProtection(nixie_display_protection_t type, uint32_t ms, uint32_t CATHODE_PROTECTION_INTER_MS)
+{
+    nixie_display_err_t ret = NO_ERR;
+    if (flush() != NO_ERR)
+    {
+        return ERR_INT;
+    }
+    ret = protectInternal(type, ms, CATHODE_PROTECTION_INTER_MS, false);
+    if (ret != NO_ERR)
+    {
+        return ret;
+    }
+    while (_display.player.active)
+    {
+        if (service() != NO_ERR)
+        {
+            return ERR_INT;
+        }
+        _platform->delayMs(1);
+    }
+    if (service() != NO_ERR)
+    {
+        return ERR_INT;
+    }
+    return ret;
+}
+
+/**
+ @brief Starts cathode protection in the background. service() shows its frames only in the gap between second edges,
+        from PROTECTION_WINDOW_START_MS to PROTECTION_WINDOW_END_MS after the last digit change, so the written digits are
+        back on the tubes before the next one
+ @param [in] type Protection visual effect
+ @param [in] ms Time to show protection frames for in ms, the run takes about ms * 1000 / (PROTECTION_WINDOW_END_MS - PROTECTION_WINDOW_START_MS)
+ @param [in] CATHODE_PROTECTION_INTER_MS Time spent on each digit in ms, default is 15
+ @return NO_ERR if no error, ERR_PARAM if invalid parameters
+ @note Replaces a protection run that is still in progress
+ */
+template <uint8_t N>
+nixie_display_err_t NixieDisplay<N>::startProtection(nixie_display_protection_t type, uint32_t ms, uint32_t CATHODE_PROTECTION_INTER_MS)
+{
+    return protectInternal(type, ms, CATHODE_PROTECTION_INTER_MS, true);
+}
+
+/**
+ @brief Stops a background protection run, the written digits are restored by the next service()
+ @return NO_ERR if no error
+ */
+template <uint8_t N>
+nixie_display_err_t NixieDisplay<N>::stopProtection()
+{
+    nixie_display_err_t ret = NO_ERR;
+    if (_display.player.protection)
+    {
+        ret = stop();
+    }
+    return ret;
+}
+
+/**
+ @brief Checks if a protection run is in progress
+ @return true if protection frames are still to be shown
+ */
+template <uint8_t N>
+bool NixieDisplay<N>::isProtecting()
+{
+    return _display.player.active && _display.player.protection;
+}
+
+/**
+ @brief Plays a frame sequence, replacing any sequence or protection run in progress. service() streams the frames
+        through commit(), paced by NixiePlatform::millis()
+ @param [in] sequence Frames to play, see nixiesequence.h
+ @param [in] repeats Number of times to play the sequence
+ @param [in] dwell Time to show frames with dwell 0 in ms, default is 15
+ @return NO_ERR if no error, ERR_PARAM if invalid parameters
+ @note The written digits are put back once the sequence is done
+ */
+template <uint8_t N>
+nixie_display_err_t NixieDisplay<N>::play(const nixie_sequence_t &sequence, uint32_t repeats, uint32_t dwell)
+{
+    nixie_display_err_t ret = NO_ERR;
+    if (sequence.frames == nullptr || sequence.length == 0 || repeats == 0 || dwell == 0)
+    {
+        return ERR_PARAM;
+    }
+    startPlayerInternal(sequence.frames, sequence.length, sequence.length * repeats, dwell, false);
+    _display.player.protection = false;
+    return ret;
+}
+
+/**
+ @brief Stops the sequence or protection run in progress, the written digits are restored by the next service()
+ @return NO_ERR if no error
+ */
+template <uint8_t N>
+nixie_display_err_t NixieDisplay<N>::stop()
+{
+    nixie_display_err_t ret = NO_ERR;
+    _display.player.active = false;
+    _display.player.shown = false;
+    return ret;
+}
+
+/**
+ @brief Checks if a sequence or protection run is in progress
+ @return true if frames are still to be shown
+ */
+template <uint8_t N>
+bool NixieDisplay<N>::isPlaying()
+{
+    return _display.player.active;
+}
+
+/**
+ @brief Internal function to set up a protection run
+ @param [in] type Protection visual effect
+ @param [in] ms Time to show protection frames for in ms
+ @param [in] inter Time spent on each digit in ms
+ @param [in] windowed Only show frames in the gap between second edges
+ @return NO_ERR if no error, ERR_PARAM if invalid parameters
+ */
+template <uint8_t N>
+nixie_display_err_t NixieDisplay<N>::protectInternal(nixie_display_protection_t type, uint32_t ms, uint32_t inter, bool windowed)
+{
+    nixie_display_err_t ret = NO_ERR;
+    static const nixie_sequence_t *const styles[] = {&NIXIE_SEQUENCE_WAVE, &NIXIE_SEQUENCE_SLOT, &NIXIE_SEQUENCE_SEQUENTIAL};
+    if (inter == 0 || ms < inter * 10 || type > CATHODE_PROTECTION_STYLE_WEIGHTED)
+    {
+        return ERR_PARAM;
+    }
+    if (type == CATHODE_PROTECTION_STYLE_WEIGHTED)
+    {
+        startPlayerInternal(nullptr, 0, planProtectionInternal(ms, inter), inter, windowed);
+    }
+    else
+    {
+        const nixie_sequence_t *sequence = styles[type];
+        startPlayerInternal(sequence->frames, sequence->length, (ms / (inter * sequence->length)) * sequence->length, inter, windowed);
+    }
+    _display.player.type = type;
+    _display.player.protection = true;
+    return ret;
+}
+
+/**
+ @brief Internal function to start the player
+ @param [in] sequence Frames to play, nullptr for weighted protection
+ @param [in] length Number of frames in the sequence
+ @param [in] frames Number of frames to show, the sequence wraps over at its end
+ @param [in] inter Time to show frames with dwell 0 in ms
+ @param [in] windowed Only show frames in the gap between second edges
+ */
+template <uint8_t N>
+void NixieDisplay<N>::startPlayerInternal(const nixie_frame_t *sequence, uint16_t length, uint32_t frames, uint32_t inter, bool windowed)
+{
+    PlayerStruct_t *p = &_display.player;
+    p->sequence = sequence;
+    p->length = length;
+    p->step = 0;
+    p->frames = frames;
+    p->inter = inter;
+    p->next = _platform->millis();
+    p->windowed = windowed;
+    p->shown = false;
+    p->active = frames > 0;
+}
+
+/**
+ @brief Internal function to advance the player to the given time
+ @param [in] now Current time from NixiePlatform::millis()
+ @note Frames are only drawn while no tube is transitioning, and for a windowed run only inside the protection window.
+       Outside of it shown is cleared, so service() puts the written digits back. Frame times are kept on a fixed
+       schedule from the first frame, so pacing does not drift with how often service() is called
+ */
+template <uint8_t N>
+void NixieDisplay<N>::servicePlayerInternal(uint32_t now)
+{
+    PlayerStruct_t *p = &_display.player;
+    uint32_t phase = (now - _display.written) % PROTECTION_WINDOW_PERIOD_MS;
+    if (isTransitioning() || (p->windowed && (phase < PROTECTION_WINDOW_START_MS || phase >= PROTECTION_WINDOW_END_MS)))
+    {
+        p->shown = false;
+        return;
+    }
+    if (p->shown && (int32_t)(now - p->next) < 0)
+    {
+        return;
+    }
+    if (p->frames == 0)
+    {
+        p->active = false;
+        p->shown = false;
+        return;
+    }
+    uint8_t frame[N];
+    uint32_t dwell = p->inter;
+    if (p->sequence == nullptr)
+    {
+        weightedFrameInternal(frame);
+    }
+    else
+    {
+        sequenceFrameInternal(p->sequence[p->step], frame);
+        if (p->sequence[p->step].dwell != 0)
+        {
+            dwell = p->sequence[p->step].dwell;
+        }
+        p->step = (p->step + 1) % p->length;
+    }
+    for (uint8_t n = 0; n < _display.active; n++)
+    {
+        lightTubeInternal(n, frame[n + _display.offset]);
+    }
+    p->frames--;
+    // stay on schedule unless the player was paused or fell more than a frame behind
+    p->next = (p->shown && now - p->next < dwell) ? p->next + dwell : now + dwell;
+    p->shown = true;
+}
+
+/**
+ @brief Internal function to unpack the digits of a sequence frame
+ @param [in] frame Right-justified BCD frame
+ @param [out] digits[] N digits of the frame, NIXIE_DIGIT_NONE for blank tubes
+ */
+template <uint8_t N>
+void NixieDisplay<N>::sequenceFrameInternal(const nixie_frame_t &frame, uint8_t digits[])
+{
+    for (uint8_t i = 0; i < N; i++)
+    {
+        uint8_t nibble = (frame.digits >> (4 * (N - 1 - i))) & 0xF;
+        digits[i] = nibble > 9 ? NIXIE_DIGIT_NONE : nibble;
+    }
+}
+
+/**
+ @brief Internal function to get the next frame of a weighted protection run
+ @param [out] digits[] N digits of the frame
+ @note Goes round robin over the cathodes with frames left, so each one is lit in short spread out pulses.
+       Tubes with no frames left show the written digit
+ */
+template <uint8_t N>
+void NixieDisplay<N>::weightedFrameInternal(uint8_t digits[])
+{
+    for (uint8_t i = 0; i < N; i++)
+    {
+        digits[i] = _display.digits[i];
+        if (i < _display.offset || i >= _display.offset + _display.active)
+        {
+            continue;
+        }
+        TubeStruct_t *t = &_display.tube[i - _display.offset];
+        uint8_t from = t->lit == NIXIE_DIGIT_NONE ? 0 : t->lit + 1;
+        for (uint8_t k = 0; k < 10; k++)
+        {
+            uint8_t d = (from + k) % 10;
+            if (t->plan[d] > 0)
+            {
+                t->plan[d]--;
+                digits[i] = d;
+                break;
+            }
+        }
+    }
+}
+
+/**
+ @brief Internal function to plan a weighted protection run from the cathode on-times since the last plan
+ @param [in] ms Most time to spend on each tube in ms
+ @param [in] inter Time spent on each digit in ms
+ @return Number of frames in the run, 0 if every cathode had enough on-time
+ @note A cathode's deficit is how far its on-time is below PROTECTION_MIN_DUTY_PERMILLE of its tube's on-time.
+       Each tube spends up to ms on its cathodes in proportion to their deficits. Tubes that are done show the written digit
+ */
+template <uint8_t N>
+uint32_t NixieDisplay<N>::planProtectionInternal(uint32_t ms, uint32_t inter)
+{
+    uint32_t frames = 0;
+    countUsageInternal();
+    for (uint8_t n = 0; n < _display.active; n++)
+    {
+        TubeStruct_t *t = &_display.tube[n];
+        uint64_t total = 0;
+        uint64_t deficit[10];
+        uint64_t sum = 0;
+        for (uint8_t d = 0; d < 10; d++)
+        {
+            total += t->recent[d];
+        }
+        uint64_t target = total * PROTECTION_MIN_DUTY_PERMILLE / 1000;
+        for (uint8_t d = 0; d < 10; d++)
+        {
+            deficit[d] = t->recent[d] < target ? target - t->recent[d] : 0;
+            sum += deficit[d];
+        }
+        uint64_t budget = sum < ms ? sum : ms;
+        uint32_t tube_frames = 0;
+        for (uint8_t d = 0; d < 10; d++)
+        {
+            uint64_t plan = sum == 0 ? 0 : budget * deficit[d] / sum / inter;
+            t->plan[d] = plan > UINT16_MAX ? UINT16_MAX : (uint16_t)plan;
+            tube_frames += t->plan[d];
+        }
+        memset(t->recent, 0, sizeof(t->recent));
+        if (tube_frames > frames)
+        {
+            frames = tube_frames;
+        }
+    }
+    return frames;
+}
+
+/**
+ @brief Gets the total on-time of a cathode, counted on each commit
+ @param [in] tube Index from left of tube, starting at 1
+ @param [in] digit Cathode digit, 0-9
+ @return On-time in ms, 0 for an invalid tube or digit
+ */
+template <uint8_t N>
+uint64_t NixieDisplay<N>::getCathodeUsage(uint8_t tube, uint8_t digit)
+{
+    if (tube < 1 || tube > _display.active || digit > 9)
+    {
+        return 0;
+    }
+    return _display.tube[tube - 1].usage[digit];
+}
+
+/**
+ @brief Clears the on-time counters of all cathodes
+ @return NO_ERR if no error
+ */
+template <uint8_t N>
+nixie_display_err_t NixieDisplay<N>::resetCathodeUsage()
+{
+    nixie_display_err_t ret = NO_ERR;
+    countUsageInternal();
+    for (uint8_t n = 0; n < N; n++)
+    {
+        memset(_display.tube[n].usage, 0, sizeof(_display.tube[n].usage));
+        memset(_display.tube[n].recent, 0, sizeof(_display.tube[n].recent));
+    }
+    return ret;
+}
+
+#endif
@@ -0,0 +1,155 @@
+/**
+ @file nixiesequence.h
+ @brief Frame sequence format for NixieDisplay::play() and the built in protection and animation sequences
+ @author Edward62740
+ */
+
+#ifndef NIXIESEQUENCE_H
+#define NIXIESEQUENCE_H
+
+#include <stdint.h>
+
+#define NIXIE_BLANK 0xF // digit nibble that blanks a tube
+#define NIXIE_SEQUENCE(frames) {frames, sizeof(frames) / sizeof(frames[0])} // nixie_sequence_t of a constexpr frame array
+
+/**
+ @brief One frame of a sequence
+ */
+typedef struct NixieFrame
+{
+    uint64_t digits; // one BCD nibble per tube, right-justified (rightmost tube in the lowest nibble), NIXIE_BLANK for a blank tube
+    uint16_t dwell; // time to show the frame in ms, 0 to use the dwell passed to the player
+} nixie_frame_t;
+
+/**
+ @brief A sequence of frames, declare the frames constexpr so they are compiled into flash
+ */
+typedef struct NixieSequence
+{
+    const nixie_frame_t *frames;
+    uint16_t length;
+} nixie_sequence_t;
+
+/* Drives 0123456789 through the tubes in order, wrapping over at the end */
+constexpr nixie_frame_t NIXIE_WAVE_FRAMES[] = {
+    {0x1234567890123456, 0},
+    {0x2345678901234567, 0},
+    {0x3456789012345678, 0},
+    {0x4567890123456789, 0},
+    {0x5678901234567890, 0},
+    {0x6789012345678901, 0},
+    {0x7890123456789012, 0},
+    {0x8901234567890123, 0},
+    {0x9012345678901234, 0},
+    {0x0123456789012345, 0}};
+
+/* Cycles through 0-9 for all the tubes */
+constexpr nixie_frame_t NIXIE_SLOT_FRAMES[] = {
+    {0x0000000000000000, 0},
+    {0x1111111111111111, 0},
+    {0x2222222222222222, 0},
+    {0x3333333333333333, 0},
+    {0x4444444444444444, 0},
+    {0x5555555555555555, 0},
+    {0x6666666666666666, 0},
+    {0x7777777777777777, 0},
+    {0x8888888888888888, 0},
+    {0x9999999999999999, 0}};
+
+/* Cycles through all digits based on physical position, front to back (for IN-14 tubes) */
+constexpr nixie_frame_t NIXIE_SEQUENTIAL_FRAMES[] = {
+    {0x1111111111111111, 0},
+    {0x0000000000000000, 0},
+    {0x2222222222222222, 0},
+    {0x9999999999999999, 0},
+    {0x3333333333333333, 0},
+    {0x8888888888888888, 0},
+    {0x4444444444444444, 0},
+    {0x7777777777777777, 0},
+    {0x5555555555555555, 0},
+    {0x6666666666666666, 0}};
+
+/* Reels spinning and slowing down */
+constexpr nixie_frame_t NIXIE_SLOT_MACHINE_FRAMES[] = {
+    {0x1234567890123456, 20},
+    {0x2345678901234567, 20},
+    {0x3456789012345678, 20},
+    {0x4567890123456789, 20},
+    {0x5678901234567890, 20},
+    {0x6789012345678901, 20},
+    {0x7890123456789012, 20},
+    {0x8901234567890123, 20},
+    {0x9012345678901234, 20},
+    {0x0123456789012345, 20},
+    {0x1234567890123456, 40},
+    {0x2345678901234567, 40},
+    {0x3456789012345678, 40},
+    {0x4567890123456789, 40},
+    {0x5678901234567890, 40},
+    {0x6789012345678901, 40},
+    {0x7890123456789012, 40},
+    {0x8901234567890123, 40},
+    {0x9012345678901234, 40},
+    {0x0123456789012345, 40},
+    {0x1234567890123456, 80},
+    {0x2345678901234567, 80},
+    {0x3456789012345678, 80},
+    {0x4567890123456789, 80},
+    {0x5678901234567890, 80},
+    {0x6789012345678901, 80},
+    {0x7890123456789012, 80},
+    {0x8901234567890123, 80},
+    {0x9012345678901234, 80},
+    {0x0123456789012345, 80}};
+
+/* Rolling odometer, each tube rolls 0-9 one frame after its right hand neighbour and stops at 9 */
+constexpr nixie_frame_t NIXIE_ODOMETER_FRAMES[] = {
+    {0xFFFFFFF000000000, 40},
+    {0xFFFFFFF000000001, 40},
+    {0xFFFFFFF000000012, 40},
+    {0xFFFFFFF000000123, 40},
+    {0xFFFFFFF000001234, 40},
+    {0xFFFFFFF000012345, 40},
+    {0xFFFFFFF000123456, 40},
+    {0xFFFFFFF001234567, 40},
+    {0xFFFFFFF012345678, 40},
+    {0xFFFFFFF123456789, 40},
+    {0xFFFFFFF234567899, 40},
+    {0xFFFFFFF345678999, 40},
+    {0xFFFFFFF456789999, 40},
+    {0xFFFFFFF567899999, 40},
+    {0xFFFFFFF678999999, 40},
+    {0xFFFFFFF789999999, 40},
+    {0xFFFFFFF899999999, 40},
+    {0xFFFFFFF999999999, 40}};
+
+/* Per-tube staggered ripple, each tube runs 0-9 one frame after its right hand neighbour and is blank otherwise */
+constexpr nixie_frame_t NIXIE_RIPPLE_FRAMES[] = {
+    {0xFFFFFFFFFFFFFFF0, 40},
+    {0xFFFFFFFFFFFFFF01, 40},
+    {0xFFFFFFFFFFFFF012, 40},
+    {0xFFFFFFFFFFFF0123, 40},
+    {0xFFFFFFFFFFF01234, 40},
+    {0xFFFFFFFFFF012345, 40},
+    {0xFFFFFFFFF0123456, 40},
+    {0xFFFFFFFF01234567, 40},
+    {0xFFFFFFF012345678, 40},
+    {0xFFFFFFF123456789, 40},
+    {0xFFFFFFF23456789F, 40},
+    {0xFFFFFFF3456789FF, 40},
+    {0xFFFFFFF456789FFF, 40},
+    {0xFFFFFFF56789FFFF, 40},
+    {0xFFFFFFF6789FFFFF, 40},
+    {0xFFFFFFF789FFFFFF, 40},
+    {0xFFFFFFF89FFFFFFF, 40},
+    {0xFFFFFFF9FFFFFFFF, 40},
+    {0xFFFFFFFFFFFFFFFF, 40}};
+
+constexpr nixie_sequence_t NIXIE_SEQUENCE_WAVE = NIXIE_SEQUENCE(NIXIE_WAVE_FRAMES);
+constexpr nixie_sequence_t NIXIE_SEQUENCE_SLOT = NIXIE_SEQUENCE(NIXIE_SLOT_FRAMES);
+constexpr nixie_sequence_t NIXIE_SEQUENCE_SEQUENTIAL = NIXIE_SEQUENCE(NIXIE_SEQUENTIAL_FRAMES);
+constexpr nixie_sequence_t NIXIE_SEQUENCE_SLOT_MACHINE = NIXIE_SEQUENCE(NIXIE_SLOT_MACHINE_FRAMES);
+constexpr nixie_sequence_t NIXIE_SEQUENCE_ODOMETER = NIXIE_SEQUENCE(NIXIE_ODOMETER_FRAMES);
+constexpr nixie_sequence_t NIXIE_SEQUENCE_RIPPLE = NIXIE_SEQUENCE(NIXIE_RIPPLE_FRAMES);
+
+#endif
@@ -0,0 +1,213 @@
+/**
+ @file host_fuzz.cpp
+ @brief Decodes the commands of corpus.txt with NixieLink and checks the results, then feeds it the corpus mutated at
+        random and times the parser. Counts heap allocations throughout, there should be none after construction
+ @note Build and run from this folder:
+       g++ -std=gnu++14 -O1 -fsanitize=address,undefined -I../.. host_fuzz.cpp ../../nixielink.cpp -o host_fuzz && ./host_fuzz
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <new>
+#include "nixielink.h"
+
+#define FUZZ_ROUNDS 200000
+#define BENCH_ROUNDS 1000000
+#define MAX_LINES 64
+#define MAX_STREAM 64
+
+/* Every heap allocation of the process goes through here */
+static uint32_t allocations = 0;
+
+void *operator new(size_t size)
+{
+    allocations++;
+    void *p = malloc(size ? size : 1);
+    if (p == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+/* One corpus line, the bytes to send and the expected decode */
+struct Line
+{
+    uint8_t stream[MAX_STREAM];
+    uint8_t len;
+    char expected[32];
+};
+
+static Line lines[MAX_LINES];
+static uint8_t lineCount = 0;
+
+static void loadCorpus(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    char text[128];
+    if (f == NULL)
+    {
+        printf("cannot open %s\n", path);
+        exit(1);
+    }
+    while (fgets(text, sizeof(text), f) != NULL && lineCount < MAX_LINES)
+    {
+        if (text[0] == '#' || text[0] == '\n')
+        {
+            continue;
+        }
+        Line &line = lines[lineCount++];
+        char *p = text;
+        line.len = 0;
+        while (*p != ' ' && *p != '\n')
+        {
+            if (strncmp(p, "<gap>", 5) == 0)
+            {
+                line.stream[line.len++] = NIXIE_LINK_GAP;
+                p += 5;
+            }
+            else if (p[0] == '\\' && (p[1] == 'n' || p[1] == 'r'))
+            {
+                line.stream[line.len++] = p[1] == 'n' ? '\n' : '\r';
+                p += 2;
+            }
+            else
+            {
+                line.stream[line.len++] = *p++;
+            }
+        }
+        while (*p == ' ')
+        {
+            p++;
+        }
+        p[strcspn(p, "\n")] = 0;
+        strcpy(line.expected, p);
+    }
+    fclose(f);
+}
+
+static void format(const nixie_link_command_t &command, char *text)
+{
+    if (command.type == NIXIE_LINK_LED)
+    {
+        sprintf(text, "L %u %u %u %u %u", command.ledMode, command.brightness, command.red, command.green, command.blue);
+    }
+    else if (command.type == NIXIE_LINK_MODE)
+    {
+        sprintf(text, "M %u", command.mode);
+    }
+    else
+    {
+        sprintf(text, "%c %u %u %u", command.type == NIXIE_LINK_TIME ? 'T' : 'C', command.hour, command.min, command.sec);
+    }
+}
+
+/* Sends one line in one write, so the gaps inside it take effect, and returns what it decoded to */
+static void decode(NixieLink &link, const Line &line, char *text)
+{
+    nixie_link_command_t command;
+    strcpy(text, "-");
+    link.write(line.stream, line.len);
+    while (link.poll(command))
+    {
+        format(command, text);
+    }
+}
+
+static uint32_t xorshift(uint32_t &seed)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+static double nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main()
+{
+    loadCorpus("corpus.txt");
+    static NixieLink link;
+    uint32_t baseline = allocations;
+
+    /* Corpus, each line on a fresh parser so the framing of one line does not carry to the next */
+    uint32_t wrong = 0;
+    for (uint8_t i = 0; i < lineCount; i++)
+    {
+        char text[32];
+        new (&link) NixieLink(); // placement new, no allocation
+        decode(link, lines[i], text);
+        if (strcmp(text, lines[i].expected) != 0)
+        {
+            printf("  %-28s decoded to %s\n", lines[i].expected, text);
+            wrong++;
+        }
+    }
+    printf("%u corpus lines, %u decoded wrong\n", (unsigned)lineCount, (unsigned)wrong);
+
+    /* Mutated corpus lines into one parser, random bytes flipped, dropped, repeated or inserted */
+    uint32_t seed = 1;
+    uint32_t decoded = 0;
+    for (uint32_t r = 0; r < FUZZ_ROUNDS; r++)
+    {
+        Line line = lines[xorshift(seed) % lineCount];
+        uint8_t mutations = xorshift(seed) % 4;
+        for (uint8_t m = 0; m < mutations && line.len > 0 && line.len < MAX_STREAM; m++)
+        {
+            uint8_t at = xorshift(seed) % line.len;
+            switch (xorshift(seed) % 4)
+            {
+                case 0: line.stream[at] = xorshift(seed); break;
+                case 1: memmove(line.stream + at, line.stream + at + 1, line.len - at - 1); line.len--; break;
+                case 2: memmove(line.stream + at + 1, line.stream + at, line.len - at); line.len++; break;
+                default: line.stream[at] = "0123456789:TCL\n"[xorshift(seed) % 15]; break;
+            }
+        }
+        nixie_link_command_t command;
+        link.write(line.stream, line.len);
+        if (xorshift(seed) % 8 == 0)
+        {
+            link.reset(); // app reconnected
+        }
+        while (link.poll(command))
+        {
+            bool valid = command.type == NIXIE_LINK_LED ? command.ledMode >= 1 && command.ledMode <= 8 && command.brightness <= 100
+                         : command.type == NIXIE_LINK_MODE ? command.mode <= 9
+                                                           : command.min < 60 && command.sec < 60 && (command.type == NIXIE_LINK_COUNTDOWN || command.hour < 24);
+            wrong += !valid;
+            decoded++;
+        }
+    }
+    printf("%u mutated commands, %u decoded, %u out of range, %u errors\n", (unsigned)FUZZ_ROUNDS, (unsigned)decoded, (unsigned)wrong,
+           (unsigned)link.getErrors());
+
+    /* Throughput on the framed time command */
+    const uint8_t time[] = "T:12:34:56\n";
+    nixie_link_command_t command;
+    double start = nowNs();
+    for (uint32_t r = 0; r < BENCH_ROUNDS; r++)
+    {
+        link.write(time, sizeof(time) - 1);
+        link.poll(command);
+    }
+    printf("%.1f ns per T:12:34:56 command\n", (nowNs() - start) / BENCH_ROUNDS);
+    printf("%u heap allocations after construction\n", (unsigned)(allocations - baseline));
+    return wrong != 0;
+}
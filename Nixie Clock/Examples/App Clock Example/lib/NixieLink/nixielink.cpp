@@ -0,0 +1,249 @@
+/**
+ @file nixielink.cpp
+ @brief Framed command protocol of the Project Nixie app link, parsed a byte at a time with no heap use
+ @author Edward62740
+ */
+
+#include "nixielink.h"
+
+NixieLink::NixieLink() : _head(0), _tail(0), _dropped(0)
+{
+    _commands = 0;
+    _errors = 0;
+    reset();
+}
+
+/**
+ @brief Restarts the parser and forgets the framing of the app, e.g. when it reconnects. Buffered bytes are kept
+ */
+void NixieLink::reset()
+{
+    _state = STATE_TYPE;
+    _framed = false;
+}
+
+/**
+ @brief Buffers received bytes, never blocks
+ @param [in] data Received bytes
+ @param [in] len Number of bytes
+ @return Number of bytes buffered, the rest is dropped if the ring is full
+ */
+uint16_t NixieLink::write(const uint8_t *data, uint16_t len)
+{
+    uint16_t head = _head.load(std::memory_order_relaxed);
+    uint16_t space = NIXIE_LINK_RING_SIZE - (uint16_t)(head - _tail.load(std::memory_order_acquire));
+    uint16_t n = len < space ? len : space;
+    for (uint16_t i = 0; i < n; i++)
+    {
+        _ring[(uint16_t)(head + i) % NIXIE_LINK_RING_SIZE] = data[i];
+    }
+    _head.store((uint16_t)(head + n), std::memory_order_release);
+    _dropped.store(_dropped.load(std::memory_order_relaxed) + (len - n), std::memory_order_relaxed);
+    return n;
+}
+
+/**
+ @brief Marks a pause in the received data, which ends a command of an app that sends no line endings
+ @return false if the ring is full and the pause was dropped
+ */
+bool NixieLink::gap()
+{
+    const uint8_t marker = NIXIE_LINK_GAP;
+    return write(&marker, 1) == 1;
+}
+
+/**
+ @brief Parses the buffered bytes up to the end of the next command, never blocks
+ @param [out] command Decoded command, only valid if true is returned
+ @return true if a command was decoded, false once the buffered bytes are used up
+ */
+bool NixieLink::poll(nixie_link_command_t &command)
+{
+    uint16_t tail = _tail.load(std::memory_order_relaxed);
+    while (tail != _head.load(std::memory_order_acquire))
+    {
+        uint8_t byte = _ring[tail % NIXIE_LINK_RING_SIZE];
+        tail++;
+        _tail.store(tail, std::memory_order_release); // the slot can be reused once the byte is read
+        if (parseInternal(byte, command))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ @brief Consumer side of gap(), for a consumer that notices the pause itself, e.g. by timing out waiting for data
+ @param [out] command Command of an app that sends no line endings, ended by the pause, only valid if true is returned
+ @return true if a command was decoded, false if not or if there are buffered bytes left to poll() first
+ */
+bool NixieLink::idle(nixie_link_command_t &command)
+{
+    if (_tail.load(std::memory_order_relaxed) != _head.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+    return parseInternal(NIXIE_LINK_GAP, command);
+}
+
+/**
+ @brief Checks if the app has been seen ending its commands with CR/LF
+ @return true if pauses in the data are ignored
+ */
+bool NixieLink::isFramed()
+{
+    return _framed;
+}
+
+/**
+ @brief Commands decoded since construction
+ */
+uint32_t NixieLink::getCommands()
+{
+    return _commands;
+}
+
+/**
+ @brief Malformed or out of range commands discarded since construction
+ */
+uint32_t NixieLink::getErrors()
+{
+    return _errors;
+}
+
+/**
+ @brief Bytes dropped because the ring was full
+ */
+uint32_t NixieLink::getDropped()
+{
+    return _dropped.load(std::memory_order_relaxed);
+}
+
+/**
+ @brief Internal function to advance the parser by one byte
+ @param [in] byte Next byte from the ring
+ @param [out] command Decoded command if true is returned
+ @return true if the byte ended a valid command
+ */
+bool NixieLink::parseInternal(uint8_t byte, nixie_link_command_t &command)
+{
+    bool end = byte == '\r' || byte == '\n';
+    if (end)
+    {
+        _framed = true;
+    }
+    else if (byte == NIXIE_LINK_GAP)
+    {
+        // a framed app may pause anywhere, even inside a command
+        end = !_framed;
+        if (!end)
+        {
+            return false;
+        }
+    }
+
+    switch (_state)
+    {
+        case STATE_TYPE:
+            if (end)
+            {
+                return false; // blank line, or the LF of a CR LF
+            }
+            if (byte == 'T' || byte == 'C' || byte == 'L' || byte == 'M')
+            {
+                _type = (char)byte;
+                _state = STATE_COLON;
+                return false;
+            }
+            break;
+        case STATE_COLON:
+            if (byte == ':')
+            {
+                _field = 0;
+                _digits = 0;
+                _fields[0] = 0;
+                _state = STATE_FIELD;
+                return false;
+            }
+            break;
+        case STATE_FIELD:
+            if (byte >= '0' && byte <= '9' && _digits < NIXIE_LINK_MAX_DIGITS)
+            {
+                _fields[_field] = _fields[_field] * 10 + (byte - '0');
+                _digits++;
+                return false;
+            }
+            if ((byte == ':' || end) && _digits > 0)
+            {
+                _widths[_field] = _digits;
+                if (end)
+                {
+                    _state = STATE_TYPE;
+                    return endInternal(command);
+                }
+                if (++_field < NIXIE_LINK_MAX_FIELDS)
+                {
+                    _digits = 0;
+                    _fields[_field] = 0;
+                    return false;
+                }
+            }
+            break;
+        case STATE_ERROR:
+            break;
+    }
+
+    // bad byte, the rest of the command is skipped up to its end
+    if (_state != STATE_ERROR)
+    {
+        _errors++;
+    }
+    _state = end ? STATE_TYPE : STATE_ERROR;
+    return false;
+}
+
+/**
+ @brief Internal function to check the fields of a complete command and decode it
+ @param [out] command Decoded command if true is returned
+ @return true if the fields are valid for the command type
+ */
+bool NixieLink::endInternal(nixie_link_command_t &command)
+{
+    uint8_t count = _field + 1;
+    bool valid;
+    if (_type == 'L')
+    {
+        valid = count == 5 && _widths[0] == 1 && _fields[0] >= 1 && _fields[0] <= 8 && _fields[1] <= 100 &&
+                _fields[2] <= 255 && _fields[3] <= 255 && _fields[4] <= 255;
+        command.type = NIXIE_LINK_LED;
+        command.ledMode = _fields[0];
+        command.brightness = _fields[1];
+        command.red = _fields[2];
+        command.green = _fields[3];
+        command.blue = _fields[4];
+    }
+    else if (_type == 'M')
+    {
+        valid = count == 1 && _widths[0] == 1;
+        command.type = NIXIE_LINK_MODE;
+        command.mode = _fields[0];
+    }
+    else
+    {
+        // hours, minutes and seconds of 1 or 2 digits, the app drops leading zeros
+        valid = count == 3 && _widths[0] <= 2 && _widths[1] <= 2 && _widths[2] <= 2 && _fields[1] < 60 && _fields[2] < 60 &&
+                (_type == 'C' || _fields[0] < 24);
+        command.type = _type == 'T' ? NIXIE_LINK_TIME : NIXIE_LINK_COUNTDOWN;
+        command.hour = _fields[0];
+        command.min = _fields[1];
+        command.sec = _fields[2];
+    }
+    if (!valid)
+    {
+        _errors++;
+        return false;
+    }
+    _commands++;
+    return true;
+}
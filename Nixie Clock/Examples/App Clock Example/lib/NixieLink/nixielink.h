@@ -0,0 +1,91 @@
+/**
+ @file nixielink.h
+ @brief Framed command protocol of the Project Nixie app link, parsed a byte at a time with no heap use
+ @author Edward62740
+ */
+
+#ifndef NIXIELINK_H
+#define NIXIELINK_H
+
+#include <stdint.h>
+#include <atomic>
+
+#define NIXIE_LINK_RING_SIZE 64 // bytes buffered between the receiver and poll(), a power of 2
+#define NIXIE_LINK_MAX_FIELDS 5 // L:A:BCD:EFG:HIJ:KLM
+#define NIXIE_LINK_MAX_DIGITS 3
+#define NIXIE_LINK_GAP 0x00 // marks a pause in the received data in the ring, never part of a command
+
+static_assert((NIXIE_LINK_RING_SIZE & (NIXIE_LINK_RING_SIZE - 1)) == 0, "NIXIE_LINK_RING_SIZE must be a power of 2");
+
+typedef enum nixie_link_types
+{
+    NIXIE_LINK_TIME, // T:HH:MM:SS, set the time
+    NIXIE_LINK_COUNTDOWN, // C:HH:MM:SS, start a countdown
+    NIXIE_LINK_LED, // L:A:BCD:EFG:HIJ:KLM, LED mode 1-8, brightness 0-100 and RGB 0-255
+    NIXIE_LINK_MODE // M:N, display mode 0-9
+} nixie_link_command_type_t;
+
+/**
+ @brief One decoded command
+ */
+typedef struct NixieLinkCommand
+{
+    nixie_link_command_type_t type;
+    uint8_t hour; // time and countdown
+    uint8_t min;
+    uint8_t sec;
+    uint8_t ledMode; // LED
+    uint8_t brightness;
+    uint8_t red;
+    uint8_t green;
+    uint8_t blue;
+    uint8_t mode; // display mode
+} nixie_link_command_t;
+
+/**
+ @class NixieLink
+ @brief Receives the app commands into a fixed ring buffer and decodes them with a state machine.
+        A command is a type letter and colon separated decimal fields of 1 to 3 digits, and ends with
+        a CR or LF. The app versions that send no line ending are still understood, their commands
+        end at the next pause in the data, see gap()
+ @note One task or callback writes and one task polls, the ring needs no lock for that. The ring indexes are atomics
+       with release/acquire ordering, so poll() never sees a byte before it is stored, also across cores
+ */
+class NixieLink
+{
+    public:
+    NixieLink();
+    void reset();
+    uint16_t write(const uint8_t *data, uint16_t len);
+    bool gap();
+    bool poll(nixie_link_command_t &command);
+    bool idle(nixie_link_command_t &command);
+    bool isFramed();
+    uint32_t getCommands();
+    uint32_t getErrors();
+    uint32_t getDropped();
+    private:
+    enum
+    {
+        STATE_TYPE, // waiting for T, C, L or M
+        STATE_COLON, // the colon after the type letter
+        STATE_FIELD, // digits of a field, or the colon or end after them
+        STATE_ERROR // discarding the rest of a bad command
+    } _state;
+    uint8_t _ring[NIXIE_LINK_RING_SIZE];
+    std::atomic<uint16_t> _head; // written by write(), free running
+    std::atomic<uint16_t> _tail; // written by poll() and idle(), free running
+    char _type;
+    uint8_t _field; // index of the field being parsed
+    uint8_t _digits; // digits of the field so far
+    uint16_t _fields[NIXIE_LINK_MAX_FIELDS];
+    uint8_t _widths[NIXIE_LINK_MAX_FIELDS];
+    bool _framed; // the app ends its commands with CR/LF, pauses are not command ends
+    uint32_t _commands;
+    uint32_t _errors;
+    std::atomic<uint32_t> _dropped; // written by write()
+    bool parseInternal(uint8_t byte, nixie_link_command_t &command);
+    bool endInternal(nixie_link_command_t &command);
+};
+
+#endif
@@ -0,0 +1,143 @@
+/**
+ @file nixiemodes.cpp
+ @brief Display modes of the clock and the scheduler that switches between them by command or timetable
+ @author Edward62740
+ */
+
+#include "nixiemodes.h"
+
+/**
+ @brief Constructor for NixieModeScheduler
+ @param [in] modes Table of modes, the index is the mode number, must outlive the scheduler
+ @param [in] count Number of modes
+ @param [in] base Mode shown from the first tick() until a command selects another
+ */
+NixieModeScheduler::NixieModeScheduler(NixieMode *const modes[], uint8_t count, uint8_t base)
+{
+    _modes = modes;
+    _count = count;
+    _slots = NULL;
+    _slotCount = 0;
+    _base = base < count ? base : 0;
+    _current = NIXIE_MODE_NONE;
+    _slot = -1;
+    _override = false;
+    _reenter = false;
+}
+
+/**
+ @brief Sets the timetable, the first slot that covers a second wins
+ @param [in] slots Timetable, must outlive the scheduler, NULL for none
+ @param [in] count Number of slots
+ */
+void NixieModeScheduler::setTimetable(const nixie_mode_slot_t *slots, uint8_t count)
+{
+    _slots = slots;
+    _slotCount = slots != NULL ? count : 0;
+}
+
+/**
+ @brief Selects the base mode by command, it is entered at the next tick() even if it is shown already
+ @param [in] mode Mode number
+ @return false if there is no such mode
+ */
+bool NixieModeScheduler::select(uint8_t mode)
+{
+    if (mode >= _count)
+    {
+        return false;
+    }
+    _base = mode;
+    _override = false;
+    _reenter = true;
+    return true;
+}
+
+/**
+ @brief Second edge, switches modes as the commands and timetable ask and ticks all modes
+ @param [in] second Second of the day
+ @return true if the frame staged before this edge is stale, write render(0) instead of committing it
+ */
+bool NixieModeScheduler::tick(uint32_t second)
+{
+    int16_t slot = slotInternal(second);
+    if (slot != _slot)
+    {
+        // a slot starts or ends, a command during a slot holds until then
+        _slot = slot;
+        _override = slot >= 0;
+    }
+    uint8_t mode = _override ? _slots[_slot].mode : _base;
+    bool stale = false;
+    for (uint8_t i = 0; i < _count; i++)
+    {
+        // every mode steps at every edge, also the one that takes over, so a hidden timer loses no second
+        if (_modes[i]->onTick(second) && i == _current)
+        {
+            stale = true;
+        }
+    }
+    if (mode != _current || _reenter)
+    {
+        _current = mode;
+        _reenter = false;
+        _modes[mode]->enter(second);
+        stale = true;
+    }
+    return stale;
+}
+
+/**
+ @brief Frame of the mode shown
+ @param [in] ahead Second edges from now, see NixieMode::render()
+ @return Number for NixieDisplay write() or stage(), 0 before the first tick()
+ */
+uint32_t NixieModeScheduler::render(uint32_t ahead)
+{
+    if (_current == NIXIE_MODE_NONE)
+    {
+        return 0;
+    }
+    return _modes[_current]->render(ahead);
+}
+
+/**
+ @brief Mode on the tubes
+ @return Mode number, NIXIE_MODE_NONE before the first tick()
+ */
+uint8_t NixieModeScheduler::getMode()
+{
+    return _current;
+}
+
+/**
+ @brief Mode selected by the last command, shown outside of the timetable slots
+ @return Mode number
+ */
+uint8_t NixieModeScheduler::getBaseMode()
+{
+    return _base;
+}
+
+/**
+ @brief Internal function to find the timetable slot covering a second
+ @param [in] second Second of the day
+ @return Index of the first slot covering it, -1 if none
+ */
+int16_t NixieModeScheduler::slotInternal(uint32_t second)
+{
+    for (uint8_t i = 0; i < _slotCount; i++)
+    {
+        const nixie_mode_slot_t &slot = _slots[i];
+        if (slot.period == 0 || slot.mode >= _count)
+        {
+            continue;
+        }
+        uint32_t into = second % slot.period;
+        if (into >= slot.start && into - slot.start < slot.length)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,87 @@
+/**
+ @file nixiemodes.h
+ @brief Display modes of the clock and the scheduler that switches between them by command or timetable
+ @author Edward62740
+ */
+
+#ifndef NIXIEMODES_H
+#define NIXIEMODES_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define NIXIE_MODE_NONE 0xFF // getMode() before the first tick()
+#define NIXIE_MODE_DAY_S 86400UL
+
+/**
+ @class NixieMode
+ @brief One thing the tubes can show, e.g. the time, a countdown or a sensor reading. onTick() runs at every second
+        edge, shown or not, so e.g. a countdown keeps running behind a timetable slot. The scheduler calls enter()
+        after onTick() on the edge the mode takes over, and render() for the frames to show
+ */
+class NixieMode
+{
+    public:
+    virtual ~NixieMode() {}
+    /**
+     @brief The mode takes over the tubes at this second edge
+     @param [in] second Second of the day
+     */
+    virtual void enter(uint32_t /*second*/) {}
+    /**
+     @brief Second edge, also called on the edge of enter(), before it
+     @param [in] second Second of the day
+     @return true if the frame rendered ahead for this edge is wrong now, e.g. the time was set, only used while shown
+     */
+    virtual bool onTick(uint32_t /*second*/) { return false; }
+    /**
+     @brief Frame to show
+     @param [in] ahead Second edges from now, 0 for the frame to show now, 1 for the frame staged for the next edge
+     @return Number for NixieDisplay write() or stage()
+     */
+    virtual uint32_t render(uint32_t ahead) = 0;
+};
+
+/**
+ @brief Timetable entry, shows a mode for length seconds from start in every period seconds of the day
+ @note {86400, 7 * 3600, 3600, ...} is 07:00-08:00 every day, {60, 30, 3, ...} is seconds 30-32 of every minute
+ */
+typedef struct NixieModeSlot
+{
+    uint32_t period; // s, a divisor of NIXIE_MODE_DAY_S
+    uint32_t start; // s into the period
+    uint32_t length; // s
+    uint8_t mode;
+} nixie_mode_slot_t;
+
+/**
+ @class NixieModeScheduler
+ @brief Switches the tubes between a table of modes. A command selects the base mode, a timetable slot shows its mode
+        for as long as it lasts and then returns to the base mode. A command during a slot ends the slot
+ @note Call tick() at every second edge after the commit of the staged frame, then stage render(1). A tick costs
+       one render and one commit, and only a mode switch or a stale frame costs a write of render(0) as well
+ */
+class NixieModeScheduler
+{
+    public:
+    NixieModeScheduler(NixieMode *const modes[], uint8_t count, uint8_t base = 0);
+    void setTimetable(const nixie_mode_slot_t *slots, uint8_t count);
+    bool select(uint8_t mode);
+    bool tick(uint32_t second);
+    uint32_t render(uint32_t ahead);
+    uint8_t getMode();
+    uint8_t getBaseMode();
+    private:
+    NixieMode *const *_modes;
+    uint8_t _count;
+    const nixie_mode_slot_t *_slots;
+    uint8_t _slotCount;
+    uint8_t _base; // mode of the last command
+    uint8_t _current; // mode on the tubes
+    int16_t _slot; // timetable slot of the last tick, -1 if none
+    bool _override; // the slot is shown instead of the base mode
+    bool _reenter; // a command asked for the base mode again, enter() it even if it is shown
+    int16_t slotInternal(uint32_t second);
+};
+
+#endif
@@ -0,0 +1,20 @@
+/*
+  Arduino.h - Minimal host shim so pcf2129rtc.cpp builds against pcf2129model.h
+*/
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+#define bitWrite(value, bit, bitvalue) ((bitvalue) ? bitSet(value, bit) : bitClear(value, bit))
+
+//Virtual time of the model, defined by the example
+uint32_t micros();
+void delay(uint32_t ms);
+
+#endif
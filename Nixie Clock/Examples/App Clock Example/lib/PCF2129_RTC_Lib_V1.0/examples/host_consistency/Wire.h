@@ -0,0 +1,79 @@
+/*
+  Wire.h - Host shim of the Arduino I2C master, every transfer goes to the pcf2129model it is attached to
+*/
+
+#ifndef TwoWire_h
+#define TwoWire_h
+
+#include "Arduino.h"
+#include "pcf2129model.h"
+
+class TwoWire
+{
+  public:
+    TwoWire() : _model(0), _first(false), _length(0), _index(0) {}
+
+    void attach(pcf2129model *model)
+    {
+      _model = model;
+    }
+
+    bool begin(int /*sda*/, int /*scl*/)
+    {
+      return true;
+    }
+
+    void beginTransmission(int /*address*/)
+    {
+      _model->start();
+      _first = true;
+    }
+
+    size_t write(uint8_t data)
+    {
+      _model->writeByte(data, _first);
+      _first = false;
+      return 1;
+    }
+
+    //A repeated start (stop = false) keeps the transaction, and the freeze, open for the following read
+    uint8_t endTransmission(bool stop = true)
+    {
+      if (stop) {
+        _model->stop();
+      }
+      return 0;
+    }
+
+    uint8_t requestFrom(int /*address*/, int len)
+    {
+      _model->start();
+      for (_length = 0; _length < len && _length < sizeof(_buffer); _length++) {
+        _buffer[_length] = _model->readByte();
+      }
+      _model->stop();
+      _index = 0;
+      return _length;
+    }
+
+    int available()
+    {
+      return _length - _index;
+    }
+
+    int read()
+    {
+      return _index < _length ? _buffer[_index++] : -1;
+    }
+
+  private:
+    pcf2129model *_model;
+    bool _first;
+    uint8_t _buffer[16];
+    uint8_t _length;
+    uint8_t _index;
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,130 @@
+/*
+  host_consistency.cpp - Reads the time from a PCF2129 register model just before a minute or hour rollover,
+  with random bus timing, and counts reads that return a time the registers never held.
+  Then sets the time aimed at a second edge and measures how far from it the first tick lands.
+  Build and run from this folder:
+    g++ -I. -I../.. host_consistency.cpp ../../pcf2129rtc.cpp -o host_consistency && ./host_consistency
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pcf2129rtc.h"
+
+#define TRIALS 100000
+
+TwoWire Wire;
+static pcf2129model model;
+
+//Every call takes 1us of virtual time, so spin loops on micros() terminate
+uint32_t micros()
+{
+  model.advance(1);
+  return (uint32_t)model.micros();
+}
+
+void delay(uint32_t ms)
+{
+  model.advance(ms * 1000);
+}
+
+//Time just before a second tick, mostly at hh:59:59 so the tick carries into the minutes and hours
+static void setupTrial(uint32_t trial)
+{
+  uint32_t day = trial % 3;
+  uint32_t hour = (trial / 3) % 23;
+  uint32_t sec = (trial % 4) ? 3599 : rand() % 3600;
+  model.setTime(day * 86400 + hour * 3600 + sec, rand() % 3000);
+}
+
+//Legacy read of the nixie task, one transaction per BCD digit
+static uint32_t readLegacy(pcf2129rtc &rtc)
+{
+  uint32_t hour = rtc.readRtcHourBCD1() * 10 + rtc.readRtcHourBCD0();
+  uint32_t min = rtc.readRtcMinBCD1() * 10 + rtc.readRtcMinBCD0();
+  uint32_t sec = rtc.readRtcSecBCD1() * 10 + rtc.readRtcSecBCD0();
+  return hour * 3600 + min * 60 + sec;
+}
+
+static uint32_t snapshotTime(const TimeSnapshot &time)
+{
+  return (time.day - 1) * 86400UL + time.hour * 3600UL + time.min * 60UL + time.sec;
+}
+
+static void run(const char *name, pcf2129rtc &rtc, bool freeze, uint8_t mode)
+{
+  uint32_t torn = 0;
+  uint32_t failed = 0;
+  model.setFreeze(freeze);
+  uint32_t transactions = model.transactions();
+  for (uint32_t trial = 0; trial < TRIALS; trial++) {
+    setupTrial(trial);
+    uint32_t before = model.time();
+    uint32_t value;
+    TimeSnapshot time;
+    if (mode == 0) {
+      value = readLegacy(rtc);
+      before %= 86400;
+    }
+    else if (mode == 1 ? rtc.readTime(time) : rtc.readTimeConsistent(time)) {
+      value = snapshotTime(time);
+    }
+    else {
+      failed++;
+      continue;
+    }
+    uint32_t after = model.time() - (mode == 0 ? model.time() / 86400 * 86400 : 0);
+    //A good read returns a time the registers held at some point during the call
+    if (value < before || value > after) {
+      torn++;
+    }
+  }
+  printf("%-44s %6u torn %6u failed %5.2f transactions/read\n", name, (unsigned)torn, (unsigned)failed,
+         (double)(model.transactions() - transactions) / TRIALS);
+}
+
+//Sets 12:34:56 so that it ticks to 12:34:57 on a second edge 1.1-2.1s ahead, returns the worst miss in us
+static uint32_t runSet(pcf2129rtc &rtc, bool aligned)
+{
+  uint32_t worst = 0;
+  for (uint32_t trial = 0; trial < TRIALS / 100; trial++) {
+    uint64_t edge = model.micros() + 1100000 + rand() % 1000000;
+    if (aligned) {
+      TimeSnapshot time = {56, 34, 12, 1, 0, 1, 21, false};
+      rtc.setDateTime(time, (uint32_t)(edge - PCF2129_STOP_TO_TICK_US));
+    }
+    else {
+      //Old path, the time is written a second before the edge and the prescaler phase is whatever it was
+      delay((uint32_t)(edge - PCF2129_MODEL_TICK_US - model.micros()) / 1000);
+      rtc.updateCurrentTimeToRTC(12, 34, 56);
+    }
+    while (model.time() % 86400 == 12 * 3600 + 34 * 60 + 56) {
+      delay(1);
+    }
+    uint64_t tick = model.lastTick();
+    uint32_t miss = (uint32_t)(tick > edge ? tick - edge : edge - tick);
+    if (miss > worst) {
+      worst = miss;
+    }
+  }
+  return worst;
+}
+
+int main()
+{
+  Wire.attach(&model);
+  pcf2129rtc rtc(21, 22);
+  model.setJitter(50, 400); //100kHz byte times plus some scheduling jitter
+
+  printf("%u reads each, registers ticking within 3ms of the read\n", TRIALS);
+  run("6 BCD digit reads", rtc, true, 0);
+  run("readTime, counters frozen", rtc, true, 1);
+  run("readTime, read split by the bus", rtc, false, 1);
+  run("readTimeConsistent, counters frozen", rtc, true, 2);
+  run("readTimeConsistent, read split by the bus", rtc, false, 2);
+
+  printf("%u sets each, first tick against the intended second edge\n", TRIALS / 100);
+  model.setFreeze(true);
+  printf("%-44s %7u us worst miss\n", "updateCurrentTimeToRTC", (unsigned)runSet(rtc, false));
+  printf("%-44s %7u us worst miss\n", "setDateTime released before the edge", (unsigned)runSet(rtc, true));
+  return 0;
+}
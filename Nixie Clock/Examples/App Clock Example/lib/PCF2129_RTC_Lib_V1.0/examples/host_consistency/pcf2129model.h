@@ -0,0 +1,200 @@
+/*
+  pcf2129model.h - Host model of the PCF2129 time registers and STOP bit, seen through the Wire shim of this folder.
+  Time advances in virtual microseconds on every bus operation, by a random amount to emulate bus and task jitter.
+*/
+
+#ifndef pcf2129model_h
+#define pcf2129model_h
+
+#include <stdint.h>
+
+#define PCF2129_MODEL_TICK_US 1000000UL
+#define PCF2129_MODEL_STOP_TO_TICK_US 507813 //Prescaler restart to the first increment
+
+class pcf2129model
+{
+  public:
+    //freeze: counters hold still from START to STOP like the real chip, false emulates a split or stalled read
+    pcf2129model() : _us(0), _nextTick(PCF2129_MODEL_TICK_US), _lastTick(0), _time(0), _pending(false), _inTransaction(false), _freeze(true),
+                     _control1(0x01), _pointer(0), _seed(1), _jitterMin(0), _jitterMax(0), _transactions(0) {}
+
+    //Sets the time as seconds since 00:00:00 of day 1, the next tick is due in tickInUs
+    void setTime(uint32_t time, uint32_t tickInUs)
+    {
+      _time = time;
+      _pending = false;
+      _nextTick = _us + tickInUs;
+    }
+
+    //Time as seconds since 00:00:00 of day 1, as the registers hold it right now
+    uint32_t time() const
+    {
+      return _time;
+    }
+
+    //Virtual time in us
+    uint64_t micros() const
+    {
+      return _us;
+    }
+
+    //Virtual time of the last seconds increment in us
+    uint64_t lastTick() const
+    {
+      return _lastTick;
+    }
+
+    void advance(uint32_t us)
+    {
+      _us += us;
+      tick();
+    }
+
+    void setFreeze(bool freeze)
+    {
+      _freeze = freeze;
+    }
+
+    //Every bus operation takes a random time between min and max us
+    void setJitter(uint32_t minUs, uint32_t maxUs)
+    {
+      _jitterMin = minUs;
+      _jitterMax = maxUs;
+    }
+
+    uint32_t transactions() const
+    {
+      return _transactions;
+    }
+
+    //START condition, the counters freeze if enabled
+    void start()
+    {
+      if (!_inTransaction) {
+        _transactions++;
+      }
+      _inTransaction = true;
+      jitter();
+    }
+
+    //STOP condition, an increment held back while frozen is applied now
+    void stop()
+    {
+      jitter();
+      _inTransaction = false;
+      if (_pending) {
+        _pending = false;
+        _time++;
+      }
+    }
+
+    void writeByte(uint8_t data, bool first)
+    {
+      jitter();
+      if (first) {
+        _pointer = data;
+      }
+      else {
+        writeReg(_pointer++, data);
+      }
+    }
+
+    uint8_t readByte()
+    {
+      jitter();
+      return reg(_pointer++);
+    }
+
+  private:
+    uint64_t _us;
+    uint64_t _nextTick;
+    uint64_t _lastTick;
+    uint32_t _time;
+    bool _pending; //At most one increment is held back while frozen
+    bool _inTransaction;
+    bool _freeze;
+    uint8_t _control1;
+    uint8_t _pointer;
+    uint32_t _seed;
+    uint32_t _jitterMin;
+    uint32_t _jitterMax;
+    uint32_t _transactions;
+
+    static uint8_t bcd(uint32_t dec)
+    {
+      return ((dec / 10) << 4) | (dec % 10);
+    }
+
+    static uint32_t dec(uint8_t bcd)
+    {
+      return (bcd >> 4) * 10 + (bcd & 0x0F);
+    }
+
+    uint8_t reg(uint8_t addr) const
+    {
+      uint32_t sec = _time % 86400;
+      switch (addr) {
+        case 0x00: return _control1;
+        case 0x03: return bcd(sec % 60);
+        case 0x04: return bcd((sec / 60) % 60);
+        case 0x05: return bcd(sec / 3600);
+        case 0x06: return bcd(1 + _time / 86400);
+        case 0x07: return (_time / 86400) % 7;
+        case 0x08: return bcd(1);
+        case 0x09: return bcd(21);
+        default: return 0;
+      }
+    }
+
+    //Only Control1 and the seconds to days registers are modelled, month and year writes are ignored
+    void writeReg(uint8_t addr, uint8_t data)
+    {
+      uint32_t day = _time / 86400;
+      uint32_t sec = _time % 86400;
+      switch (addr) {
+        case 0x00:
+          if ((_control1 & 0x20) && !(data & 0x20)) {
+            //STOP released, the prescaler starts counting from 0
+            _nextTick = _us + PCF2129_MODEL_STOP_TO_TICK_US;
+          }
+          _control1 = data;
+          break;
+        case 0x03: _time = day * 86400 + sec / 60 * 60 + dec(data & 0x7F); break;
+        case 0x04: _time = day * 86400 + sec / 3600 * 3600 + dec(data & 0x7F) * 60 + sec % 60; break;
+        case 0x05: _time = day * 86400 + dec(data & 0x3F) * 3600 + sec % 3600; break;
+        case 0x06: _time = (dec(data & 0x3F) - 1) * 86400 + sec; break;
+        default: break;
+      }
+    }
+
+    void jitter()
+    {
+      _seed ^= _seed << 13;
+      _seed ^= _seed >> 17;
+      _seed ^= _seed << 5;
+      _us += _jitterMin + (_jitterMax > _jitterMin ? _seed % (_jitterMax - _jitterMin + 1) : 0);
+      tick();
+    }
+
+    void tick()
+    {
+      if (_control1 & 0x20) {
+        //Stopped, no increments until the release
+        _nextTick = _us + PCF2129_MODEL_TICK_US;
+        _pending = false;
+        return;
+      }
+      while (_us >= _nextTick) {
+        _lastTick = _nextTick;
+        _nextTick += PCF2129_MODEL_TICK_US;
+        if (_inTransaction && _freeze) {
+          _pending = true;
+        }
+        else {
+          _time++;
+        }
+      }
+    }
+};
+
+#endif
@@ -76,6 +76,48 @@ void pcf2129rtc::updateCurrentTimeToRTC(int initHour, int initMin, int initSec)
   Wire.endTransmission();
 }
 
+bool pcf2129rtc::setDateTime(const TimeSnapshot &time, uint32_t releaseMicros)
+{
+  //Keep the other Control1 bits (SI, 12/24h) as configured
+  uint8_t control1;
+  if (!readRegs(PCF2129_REG_CONTROL1, &control1, 1)) {
+    return false;
+  }
+
+  //Freeze the counters and reset the prescaler
+  Wire.beginTransmission(PCF2129_ADDRESS);
+  Wire.write(PCF2129_REG_CONTROL1);
+  Wire.write(control1 | PCF2129_CONTROL1_STOP);
+  if (Wire.endTransmission() != 0) {
+    return false;
+  }
+
+  //Seconds to years in one burst, writing the seconds also clears the oscillator stop flag
+  Wire.beginTransmission(PCF2129_ADDRESS);
+  Wire.write(PCF2129_REG_SECONDS);
+  Wire.write(decToBcd(time.sec));
+  Wire.write(decToBcd(time.min));
+  Wire.write(decToBcd(time.hour));
+  Wire.write(decToBcd(time.day));
+  Wire.write(time.weekday);
+  Wire.write(decToBcd(time.month));
+  Wire.write(decToBcd(time.year));
+  bool ok = Wire.endTransmission() == 0;
+
+  //Yield until just before the release, then spin for the last ms. A release time already passed releases now
+  while ((int32_t)(releaseMicros - micros()) > 2000) {
+    delay(1);
+  }
+  while ((int32_t)(releaseMicros - micros()) > 0) {
+  }
+
+  //Release even if the time write failed, so the RTC is never left stopped
+  Wire.beginTransmission(PCF2129_ADDRESS);
+  Wire.write(PCF2129_REG_CONTROL1);
+  Wire.write(control1 & ~PCF2129_CONTROL1_STOP);
+  return Wire.endTransmission() == 0 && ok;
+}
+
 int pcf2129rtc::readRtcHour()
 {
   //Read hour from RTC
@@ -115,6 +157,57 @@ int pcf2129rtc::readRtcSec()
   return _rtcSec;
 }
 
+bool pcf2129rtc::readTime(TimeSnapshot &time)
+{
+  //Burst read seconds to years, the register address auto-increments after each byte
+  uint8_t regs[PCF2129_TIME_REGS];
+  if (!readRegs(PCF2129_REG_SECONDS, regs, PCF2129_TIME_REGS)) {
+    return false;
+  }
+
+  //Mask the flag and unused bits of each register before decoding
+  time.osf = regs[0] & 0x80;
+  time.sec = bcdToDec(regs[0] & 0x7F);
+  time.min = bcdToDec(regs[1] & 0x7F);
+  time.hour = bcdToDec(regs[2] & 0x3F);
+  time.day = bcdToDec(regs[3] & 0x3F);
+  time.weekday = regs[4] & 0x07;
+  time.month = bcdToDec(regs[5] & 0x1F);
+  time.year = bcdToDec(regs[6]);
+  return true;
+}
+
+bool pcf2129rtc::readTimeConsistent(TimeSnapshot &time)
+{
+  //The PCF2129 freezes its counters while a transaction is in progress, so a burst is coherent on its own.
+  //If the bus splits or stalls the read, a tick can still land between the bytes: seconds are read first,
+  //so if they are unchanged after the burst no rollover can have reached the minutes, hours or date
+  for (uint8_t i = 0; i < PCF2129_READ_RETRIES; i++) {
+    uint8_t sec;
+    if (readTime(time) && readRegs(PCF2129_REG_SECONDS, &sec, 1) && bcdToDec(sec & 0x7F) == time.sec) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool pcf2129rtc::readRegs(uint8_t reg, uint8_t *data, uint8_t len)
+{
+  //Write the register address, then read with a repeated start so the counters stay frozen
+  Wire.beginTransmission(PCF2129_ADDRESS);
+  Wire.write(reg);
+  if (Wire.endTransmission(false) != 0) {
+    return false;
+  }
+  if (Wire.requestFrom(PCF2129_ADDRESS, (int)len) != len) {
+    return false;
+  }
+  for (uint8_t i = 0; i < len; i++) {
+    data[i] = Wire.read();
+  }
+  return true;
+}
+
 int pcf2129rtc::clearMsf()
 {
   //Control reg 2 confing
@@ -190,6 +283,11 @@ int pcf2129rtc::readRtcHourBCD1()
   return _rtcHourBCD1;
 }
 
+uint8_t pcf2129rtc::bcdToDec(uint8_t bcd)
+{
+  return (bcd >> 4) * 10 + (bcd & 0x0F);
+}
+
 int pcf2129rtc::decToBcd(int dec)
 {
   _dec = dec;
@@ -10,6 +10,33 @@
 #include "Arduino.h"
 #include "Wire.h" 
 
+#define PCF2129_ADDRESS 0x51
+#define PCF2129_REG_CONTROL1 0x00
+#define PCF2129_CONTROL1_STOP 0x20 //Freezes the time counters and resets the prescaler
+#define PCF2129_STOP_TO_TICK_US 507813 //First seconds increment after STOP is released, the prescaler restarts from 0
+#define PCF2129_REG_SECONDS 0x03 //First of the 7 time/date registers (seconds, minutes, hours, days, weekdays, months, years)
+#define PCF2129_TIME_REGS 7
+#define PCF2129_READ_RETRIES 3 //Burst reads tried by readTimeConsistent() before giving up
+
+//Decoded contents of the time/date registers, read in one transaction by readTime()
+struct TimeSnapshot
+{
+  uint8_t sec; //0-59
+  uint8_t min; //0-59
+  uint8_t hour; //0-23
+  uint8_t day; //1-31
+  uint8_t weekday; //0-6
+  uint8_t month; //1-12
+  uint8_t year; //0-99
+  bool osf; //Oscillator stop flag, the time may be invalid
+
+  //Time as an HHMMSS integer
+  uint32_t hhmmss() const
+  {
+    return hour * 10000UL + min * 100UL + sec;
+  }
+};
+
 class pcf2129rtc
 {
   public:
@@ -21,6 +48,11 @@ class pcf2129rtc
             
     //Write current real world time to RTC
     void updateCurrentTimeToRTC(int initHour, int initMin, int initSec);  
+
+    //Stop the RTC, write all time/date registers in one transaction and restart it when micros() reaches releaseMicros.
+    //The registers tick over from time PCF2129_STOP_TO_TICK_US after the release, so to land that tick on a second edge
+    //release PCF2129_STOP_TO_TICK_US before it. Returns false if a write failed
+    bool setDateTime(const TimeSnapshot &time, uint32_t releaseMicros);
     
     //Reset interrupt
     int clearMsf();
@@ -30,6 +62,12 @@ class pcf2129rtc
     int readRtcMin();
     int readRtcSec();
 
+    //Read all time/date registers in one I2C transaction, returns false if the read failed
+    bool readTime(TimeSnapshot &time);
+
+    //Read all time/date registers and re-read them if the seconds ticked over during the read, returns false if no consistent read was made
+    bool readTimeConsistent(TimeSnapshot &time);
+
     //Read time in BCD 
     int readRtcHourBCD0();
     int readRtcHourBCD1();
@@ -68,6 +106,12 @@ class pcf2129rtc
     int _rtcHourBCD0;
     int _rtcHourBCD1; 
 
+    //Read len consecutive registers starting at reg in one transaction
+    bool readRegs(uint8_t reg, uint8_t *data, uint8_t len);
+
+    //Convert BCD register value to decimal
+    static uint8_t bcdToDec(uint8_t bcd);
+
     //Convert decimal integer to BCD integer function
     int decToBcd(int dec);
         //decToBcd() internal Vars
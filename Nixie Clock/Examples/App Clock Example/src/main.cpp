@@ -4,11 +4,24 @@
 #include <NTC_PCA9698.h> //Port Expander lib
 #include "nixiedisplay.h" //Nixie Tube Driver Lib
 #include "BluetoothSerial.h" //Bluetooth lib
+#include "nixielink.h" //App command parser lib
+#include "commandqueue.h" //Cross-core command queue lib
+#include "countdowntimer.h" //Countdown and stopwatch lib
+#include "nixiemodes.h" //Display mode scheduler lib
 #include <WS2812FX.h> //RGB LED lib
+#include <esp_freertos_hooks.h> //Idle hook
 
-bool platformGPIOWrite(uint8_t pin, bool data);
-void platformDelayMs(uint32_t ms);
 void disableSubsystems();
+int readRtcTime();
+int nextSecond(int hhmmss);
+uint32_t hhmmssToSecond(int hhmmss);
+bool pollAppLink();
+void queueCommand(const nixie_link_command_t &command);
+void takeNixieCommands();
+void wakeTask(void *handle);
+void onCountdownExpired(void *arg);
+void btDataCallback(const uint8_t *buffer, size_t size);
+void reportCommandLatency();
 void btTask(void * pvParameters);
 void ledTask(void * pvParameters);
 void nixieTask(void * pvParameters);
@@ -27,64 +40,185 @@ void nixieTask(void * pvParameters);
 #define pwrLed         26 //Power LED for power system (5V & 170V) status
 #define comLed         27 //Fast Blinking if not connected to app... Slow Blinking if connected to app
 
-
-/* Nixie tube pinouts (HW Version 1)
-uint8_t pinout1[10] = {9, 0, 1, 2, 3, 4, 5, 6, 7, 8};
-uint8_t pinout2[10] = {27, 10, 11, 12, 13, 14, 15, 24, 25, 26};
-uint8_t pinout3[10] = {39, 28, 29, 30, 31, 34, 35, 36, 37, 38};
-uint8_t pinout4[10] = {49, 40, 41, 42, 43, 44, 45, 46, 47, 48};
-uint8_t pinout5[10] = {67, 50, 51, 52, 53, 54, 55, 64, 65, 66};
-uint8_t pinout6[10] = {79, 68, 69, 70, 71, 74, 75, 76, 77, 78}; */
-
-/* Nixie tube pinouts (HW Version 2)*/
-uint8_t pinout1[10] = {5, 4, 3, 2, 1, 0, 9, 8, 7, 6};
-uint8_t pinout2[10] = {15, 14, 13, 12, 11, 10, 27, 26, 25, 24};
-uint8_t pinout3[10] = {35, 34, 31, 30, 29, 28, 39, 38, 37, 36};
-uint8_t pinout4[10] = {45, 44, 43, 42, 41, 40, 49, 48, 47, 46};
-uint8_t pinout5[10] = {55, 54, 53, 52, 51, 50, 67, 66, 65, 64};
-uint8_t pinout6[10] = {75, 74, 71, 70, 69, 68, 79, 78, 77, 76};
+/* Uncomment to print the RTC second edge to display commit latency over serial once a minute */
+//#define DEBUG_LATENCY
+/* Uncomment to print the idle time of core 1 over serial once a second */
+//#define DEBUG_IDLE
+/* Uncomment to print the packet to dispatch and packet to display latency of every app command over serial */
+//#define DEBUG_BT_LATENCY
+
+/* A pause this long ends a command from app versions that send no line ending */
+#define btGapMs 50
+/* The LEDs blink red this long when a countdown runs out */
+#define countdownAlertMs 5000
+
+/* Nixie tube pinouts, select the board with NIXIE_HW_VERSION */
+#ifndef NIXIE_HW_VERSION
+#define NIXIE_HW_VERSION 2
+#endif
+
+#if NIXIE_HW_VERSION == 1
+constexpr uint8_t pinouts[6][10] = {
+  {9, 0, 1, 2, 3, 4, 5, 6, 7, 8},
+  {27, 10, 11, 12, 13, 14, 15, 24, 25, 26},
+  {39, 28, 29, 30, 31, 34, 35, 36, 37, 38},
+  {49, 40, 41, 42, 43, 44, 45, 46, 47, 48},
+  {67, 50, 51, 52, 53, 54, 55, 64, 65, 66},
+  {79, 68, 69, 70, 71, 74, 75, 76, 77, 78}};
+#else
+constexpr uint8_t pinouts[6][10] = {
+  {5, 4, 3, 2, 1, 0, 9, 8, 7, 6},
+  {15, 14, 13, 12, 11, 10, 27, 26, 25, 24},
+  {35, 34, 31, 30, 29, 28, 39, 38, 37, 36},
+  {45, 44, 43, 42, 41, 40, 49, 48, 47, 46},
+  {55, 54, 53, 52, 51, 50, 67, 66, 65, 64},
+  {75, 74, 71, 70, 69, 68, 79, 78, 77, 76}};
+#endif
+
+/* Tube/digit -> expander/port/bit table, generated at compile time */
+static_assert(nixiePinoutsUnique(pinouts), "two cathodes are routed to the same expander pin");
+static_assert(nixiePinoutsInRange(pinouts), "cathode routed past the last expander");
+constexpr NixieRouteTable<6> routes = nixieRoutes(pinouts);
 
 /* Nixie tube driver-specific parameters */
 uint8_t active = 6; //6 active tubes
 uint8_t offset = 0; //Do not offset
 
+/* Nixie tube driver platform - writes cathodes to the port expanders and uses FreeRTOS for timing */
+class ExpanderPlatform : public NixiePlatform {
+  public:
+    bool portWrite(uint8_t chip, uint8_t port, const uint8_t *data, uint8_t len);
+    void delayMs(uint32_t ms);
+    uint32_t millis();
+};
+
+/* Display modes, the number is the index in modeTable and what the app sends with M:N */
+#define MODE_TIME      0 //Time of day from the RTC
+#define MODE_COUNTDOWN 1 //Countdown started by C:HH:MM:SS
+#define MODE_STOPWATCH 2 //Stopwatch started by M:2
+
+//Time of day, from the RTC second the scheduler is ticked with
+class TimeMode : public NixieMode {
+  public:
+    void enter(uint32_t second) {
+      _second = second;
+    }
+    bool onTick(uint32_t second) {
+      //The time was set or an edge was missed if this is not the second after the last one
+      bool stale = second != (_second + 1) % NIXIE_MODE_DAY_S;
+      _second = second;
+      return stale;
+    }
+    uint32_t render(uint32_t ahead) {
+      uint32_t second = (_second + ahead) % NIXIE_MODE_DAY_S;
+      return second / 3600 * 10000 + second / 60 % 60 * 100 + second % 60;
+    }
+  private:
+    uint32_t _second = 0;
+};
+
+//Countdown or stopwatch, keeps running while another mode is shown
+class TimerMode : public NixieMode {
+  public:
+    TimerMode(CountdownTimer &timer, countdown_direction_t direction) : _timer(timer), _direction(direction) {}
+    //Starts the timer from ms at the next enter(), a plain mode switch shows it where it is. onTick() steps it at every
+    //edge, also the one it is entered on, so switching away and back loses no second
+    void load(uint32_t ms, uint32_t sinceMicros) {
+      _startMs = ms;
+      _sinceMicros = sinceMicros;
+      _load = true;
+    }
+    void enter(uint32_t /*second*/) {
+      if (_load) {
+        //The timer started when the command arrived, the part of a second up to this edge is stepped here and the
+        //edges of the RTC step the rest, the RTC is not set for it
+        int32_t elapsedMs = (int32_t)(micros() - _sinceMicros) / 1000;
+        _timer.start(_startMs, _direction);
+        _timer.tick(elapsedMs > 0 ? elapsedMs : 0);
+        _load = false;
+      }
+    }
+    bool onTick(uint32_t /*second*/) {
+      _timer.tick();
+      return false;
+    }
+    uint32_t render(uint32_t ahead) {
+      return _timer.hhmmss(ahead * COUNTDOWN_SECOND_MS);
+    }
+  private:
+    CountdownTimer &_timer;
+    countdown_direction_t _direction;
+    uint32_t _startMs = 0;
+    uint32_t _sinceMicros = 0; //micros() when the command arrived
+    bool _load = false;
+};
+
+/* App command as queued from btTask to nixieTask and ledTask */
+typedef struct AppCommand
+{
+  nixie_link_command_t link;
+  uint32_t rxMicros; //micros() when the packet completing the command arrived
+  uint32_t dispatchMicros; //micros() when btTask queued it
+} app_command_t;
+
 /* Objects */
 pcf2129rtc pcf2129rtcInstance(twimIntSDA, twimIntSCL);
 BluetoothSerial espBt;
+NixieLink appLink; //Frames and decodes the app commands in a fixed ring buffer, no String or heap use
+CommandQueue<app_command_t, 8> nixieQueue; //Time, countdown and mode commands from btTask on core 0 to nixieTask on core 1
+CommandQueue<app_command_t, 8> ledQueue; //LED commands from btTask to ledTask
+CommandQueue<uint8_t, 4> alertQueue; //Countdown and stopwatch expiries from nixieTask to ledTask
+CountdownTimer countdown; //Countdown of countdown mode, stepped by the RTC second edges in nixieTask
+CountdownTimer stopwatch; //Stopwatch of stopwatch mode
+TimeMode timeMode;
+TimerMode countdownMode(countdown, COUNTDOWN_DOWN);
+TimerMode stopwatchMode(stopwatch, COUNTDOWN_UP);
+NixieMode *const modeTable[] = {&timeMode, &countdownMode, &stopwatchMode};
+NixieModeScheduler modes(modeTable, sizeof(modeTable) / sizeof(modeTable[0]), MODE_TIME); //Only touched by nixieTask
 WS2812FX ws2812fx = WS2812FX(6, ledBus, NEO_GRB + NEO_KHZ800);
-NixieDisplay display(active, offset, pinout1, pinout2, pinout3, pinout4, pinout5, pinout6);
+ExpanderPlatform nixiePlatform;
+NixieDisplay<6> display(nixiePlatform, active, offset, routes);
 PCA9698 expanderChip0(0x20, twimIntSDA, twimIntSCL, (uint32_t)400000); //(I2C_ADDR,SDA,SCL,SPEED)
 PCA9698 expanderChip1(0x21, twimIntSDA, twimIntSCL, (uint32_t)400000);
 
 /* Global variables */
-bool setHardwareMode = true; //true = Time Mode | false = Countdown Mode | Default = Time Mode
-bool updateRtcFlag = false; //Alerts core 1 that RTC has to be updated
-bool updateLedFlag = false;
-bool timeInitFlag = false;
-bool countdownInitFlag = false;
+//RTC update of nixieTask, only touched by nixieTask, commands reach it through nixieQueue
+bool updateRtcFlag = false; //Alerts core 1 that RTC has to be set to rxHour, rxMin and rxSec
 int rxHour = 0;
 int rxMin = 0;
 int rxSec = 0;
-int ledModeNum = 0;
-int ledBrightnessVar = 0;
-int redVar = 0;
-int greenVar = 0;
-int blueVar = 0;
+unsigned long rxMicros = 0; //micros() when the last time message arrived
+volatile uint32_t btRxMicros = 0; //micros() when the last Bluetooth packet arrived, set by btDataCallback
 unsigned long catProInitTime = 0; //Cathode Protection Initial Time
 
-/* Input data buffer */
-char recDataBuf[20] = "";
-
 /* RTC variables */
-int rtcTimeConcat = 0;
-int rtcTimeConcatPrev = 999999;
-
-/* Countdown variables */
-int rxTimeConcat = 0;
-int rxTimeConcatPrev = 999999;
-
-/* Seconds Interrupt Flag */
-bool secIntFlag = false;
+uint32_t clockSecond = 0; //Second of the day at the last RTC second edge
+bool frameStaged = false; //A frame is staged on the display for the next second edge
+
+/* Seconds Interrupt Flag, the ISR also notifies nixieTask so it can block until then */
+volatile bool secIntFlag = false;
+volatile uint32_t secIntMicros = 0; //micros() at the last RTC second edge
+TaskHandle_t nixieTaskHandle = NULL;
+TaskHandle_t btTaskHandle = NULL;
+TaskHandle_t ledTaskHandle = NULL;
+
+/* Core 1 idle time, measured from the idle hook to the next wake of nixieTask */
+volatile bool core1Idle = false;
+volatile uint32_t core1IdleStart = 0;
+uint32_t core1IdleAccum = 0;
+uint32_t core1IdleWindow = 0;
+uint32_t core1IdleUs = 0; //Time core 1 spent idle over the last second in us
+
+#ifdef DEBUG_BT_LATENCY
+app_command_t cmdShown; //Last time, countdown or mode command taken by nixieTask
+char cmdPending = 0; //Type letter of cmdShown until it shows, 0 if none
+#endif
+
+#ifdef DEBUG_LATENCY
+uint32_t latencySum = 0;
+uint32_t latencyMax = 0;
+uint32_t latencyCount = 0;
+#endif
 
 /* Secrets */
 String ID = "7C0A";
@@ -95,7 +229,24 @@ String ID = "7C0A";
    @param void
 */
 void IRAM_ATTR rtcIntISR() {
+  BaseType_t woken = pdFALSE;
+  secIntMicros = micros();
   secIntFlag = true;
+  vTaskNotifyGiveFromISR(nixieTaskHandle, &woken);
+  portYIELD_FROM_ISR(woken);
+}
+
+/*! core1IdleHook() :: HOOK
+   @brief called by the idle task of core 1 whenever it runs, marks the start of an idle period
+   @note returns true so the idle task waits for the next interrupt
+   @param void
+*/
+bool core1IdleHook() {
+  if (!core1Idle) {
+    core1IdleStart = micros();
+    core1Idle = true;
+  }
+  return true;
 }
 
 
@@ -105,6 +256,9 @@ void IRAM_ATTR rtcIntISR() {
    @param void
 */
 void setup() {
+#if defined(DEBUG_LATENCY) || defined(DEBUG_IDLE) || defined(DEBUG_BT_LATENCY)
+  Serial.begin(115200);
+#endif
 
   //IO Definitions
   pinMode(rtcInt, INPUT_PULLUP); //***Interrupt pin has to be set as input pullup***
@@ -122,6 +276,13 @@ void setup() {
   digitalWrite(en5V, HIGH);
   digitalWrite(en170V, LOW);
 
+  //Wake the consumer task of each queue on every command, the handles are filled in as the tasks are created
+  nixieQueue.setNotify(wakeTask, &nixieTaskHandle);
+  ledQueue.setNotify(wakeTask, &ledTaskHandle);
+  alertQueue.setNotify(wakeTask, &ledTaskHandle);
+  countdown.setExpiredHook(onCountdownExpired, NULL);
+  stopwatch.setExpiredHook(onCountdownExpired, NULL);
+
   //Core 0 Config
   xTaskCreatePinnedToCore(
     btTask, //Task Function
@@ -129,7 +290,7 @@ void setup() {
     10000,        //Stack size of task
     NULL,         //Parameter of the task
     2,            //Priority of the task
-    NULL,       //Task handle to keep track of the created task
+    &btTaskHandle,       //Task handle to keep track of the created task
     0);           //Target Core
 
   //Core 1 Config
@@ -139,13 +300,17 @@ void setup() {
     10000,        //Stack size of task
     NULL,         //Parameter of the task
     3,            //Priority of the task
-    NULL,       //Task handle to keep track of the created task
+    &nixieTaskHandle,       //Task handle to keep track of the created task
     1);           //Target Core
-    
+
+  esp_register_freertos_idle_hook_for_cpu(core1IdleHook, 1);
+
+  //Loop isn't used as all the code has been separated into tasks and run explicitly on core 0 and 1
+  //Delete the Arduino loop task so it doesn't spin on core 1
+  vTaskDelete(NULL);
 }
 
 void loop() {
-  //Loop isn't used as all the code has been separated into tasks and run explicitly on core 0 and 1
 }
 
 
@@ -161,199 +326,188 @@ void disableSubsystems() {
   ws2812fx.stop();
 }
 
+//Reads the current RTC time as HHMMSS in a single burst, re-read if it straddled a tick, -1 if the read failed
+int readRtcTime() {
+  TimeSnapshot time;
+  if (!pcf2129rtcInstance.readTimeConsistent(time)) {
+    return -1;
+  }
+  return time.hhmmss();
+}
 
+//Returns the second of the day of an HHMMSS time
+uint32_t hhmmssToSecond(int hhmmss) {
+  return hhmmss / 10000 * 3600UL + (hhmmss / 100) % 100 * 60UL + hhmmss % 100;
+}
 
-/*! btTask() :: TASK
-   @brief enables bt, rx data from app, sets flags to inform nixieTask and ledTask
-   @note none
-   @param void
-*/
-void btTask(void * pvParameters) {
+//Returns the HHMMSS one second after hhmmss, wrapping over at midnight
+int nextSecond(int hhmmss) {
+  int hour = hhmmss / 10000;
+  int min = (hhmmss / 100) % 100;
+  int sec = hhmmss % 100 + 1;
+  if (sec == 60) {
+    sec = 0;
+    min++;
+  }
+  if (min == 60) {
+    min = 0;
+    hour++;
+  }
+  if (hour == 24) {
+    hour = 0;
+  }
+  return hour * 10000 + min * 100 + sec;
+}
 
-  //Name of BT signal
-  //This will be the name shown to other BT devices in the BT network
-  //ID is defined above and is unique to each clock (This is to prevent multiple clocks from having the same name on the BT network)
-  espBt.begin("Nixie_Clock_" + ID);
 
-  while (1) {
-    //If app data has been received from app side...
-    if (espBt.available()) {
-      //Receive data from app via Bt
-      String recDataString = espBt.readString();
-      //Serial.println("Data Received From App: " + recDataString);
-      //Serial.println("Processing Data Received...");
-
-      //Clear the array
-      for (int i = 0; i < 20; i++) {
-        recDataBuf[i] = '\0';
-      }
 
-      recDataString.toCharArray(recDataBuf, (recDataString.length() + 1));
-
-      //Process what kind of data it is (time/countdown/LED)and accordingly store to time/countdown/LED vars
-      /*Standard format of data on Project Nixe Bluetooth Link:
-         A:BC:DE:FG
-           A = T (Time Mode) / C (Countdown Mode) / L (Config LED)
-         B-C = Hours
-         D-E = Mins
-         F-G = Secs
-      */
-
-      //Time decoding
-      //This decoding is necessary as the time sent by the android system varies in format for diff times
-      if (recDataString.length() == 10) {
-        //Format: T:HH:MM:SS or C:HH:MM:SS
-        rxHour = (String(recDataBuf[2]) + String(recDataBuf[3])).toInt();
-        rxMin = (String(recDataBuf[5]) + String(recDataBuf[6])).toInt();
-        rxSec = (String(recDataBuf[8]) + String(recDataBuf[9])).toInt();
-      }
-      else if (recDataString.length() == 9) {
-        if (recDataBuf[4] == ':') {
-          if (recDataBuf[7] == ':') {
-            //Format: T:HH:MM:S or C:HH:MM:S
-            rxHour = (String(recDataBuf[2]) + String(recDataBuf[3])).toInt();
-            rxMin = (String(recDataBuf[5]) + String(recDataBuf[6])).toInt();
-            rxSec = (String(recDataBuf[8])).toInt();
-          }
-          else {
-            //Format: T:HH:M:SS or C:HH:M:SS
-            rxHour = (String(recDataBuf[2]) + String(recDataBuf[3])).toInt();
-            rxMin = (String(recDataBuf[5])).toInt();
-            rxSec = (String(recDataBuf[7]) + String(recDataBuf[8])).toInt();
-          }
-        }
-        else if (recDataBuf[3] == ':') {
-          //Format: T:H:MM:SS or C:H:MM:SS
-          rxHour = (String(recDataBuf[2])).toInt();
-          rxMin = (String(recDataBuf[4]) + String(recDataBuf[5])).toInt();
-          rxSec = (String(recDataBuf[7]) + String(recDataBuf[8])).toInt();
-        }
-      }
-      else if (recDataString.length() == 7) {
-        //Format: T:H:M:S or C:H:M:S
-        rxHour = (String(recDataBuf[2])).toInt();
-        rxMin = (String(recDataBuf[4])).toInt();
-        rxSec = (String(recDataBuf[6])).toInt();
-      }
-      if (recDataString.length() == 8) {
-        if (recDataBuf[3] == ':') {
-          if (recDataBuf[5] == ':') {
-            //Format: T:H:M:SS or C:H:M:SS
-            rxHour = (String(recDataBuf[2])).toInt();
-            rxMin = (String(recDataBuf[4])).toInt();
-            rxSec = (String(recDataBuf[6]) + String(recDataBuf[7])).toInt();
-          }
-          else {
-            //Format: T:H:MM:S or C:H:MM:S
-            rxHour = (String(recDataBuf[2])).toInt();
-            rxMin = (String(recDataBuf[4]) + String(recDataBuf[5])).toInt();
-            rxSec = (String(recDataBuf[7]) + String(recDataBuf[8])).toInt();
-          }
-        }
-        else if (recDataBuf[4] == ':') {
-          //Format: T:HH:M:S or C:HH:M:S
-          //Serial.println("2");
-          rxHour = (String(recDataBuf[2]) + String(recDataBuf[3])).toInt();
-          rxMin = (String(recDataBuf[5])).toInt();
-          rxSec = (String(recDataBuf[7])).toInt();
-        }
+//Decodes the commands buffered in the link and applies them, returns true if there was at least one
+bool pollAppLink() {
+  nixie_link_command_t command;
+  bool decoded = false;
+  while (appLink.poll(command)) {
+    queueCommand(command);
+    decoded = true;
+  }
+  return decoded;
+}
+
+//Queues a decoded app command to the task that carries it out, nixieTask or ledTask
+/*Commands on Project Nixie Bluetooth Link, see nixielink.h:
+   T:HH:MM:SS = Time Mode, set the time
+   C:HH:MM:SS = Countdown Mode, count down from the time
+   L:A:BCD:EFG:HIJ:KLM = Config LED, mode 1-8, brightness 0-100 and RGB 0-255
+   M:N = Display mode N, see MODE_TIME, M:2 starts the stopwatch unless it is running
+*/
+void queueCommand(const nixie_link_command_t &command) {
+  app_command_t queued;
+  queued.link = command;
+  //The received time is taken as current from the packet that completed the command
+  queued.rxMicros = btRxMicros;
+  queued.dispatchMicros = micros();
+
+  //A full queue drops the command and counts it, the app sent faster than the task could follow
+  CommandQueue<app_command_t, 8> &queue = command.type == NIXIE_LINK_LED ? ledQueue : nixieQueue;
+  if (!queue.push(queued)) {
+#ifdef DEBUG_BT_LATENCY
+    Serial.printf("[BT] Command dropped, %u overflows\n", queue.getOverflows());
+#endif
+  }
+}
+
+
+//Takes the queued time, countdown and mode commands, selects the modes and sets the RTC update for the rest of nixieTask
+void takeNixieCommands() {
+  app_command_t command;
+  while (nixieQueue.pop(command)) {
+    const nixie_link_command_t &link = command.link;
+    if (link.type == NIXIE_LINK_MODE) {
+      //The stopwatch starts from 0 when it is selected and not running, else it is shown where it is
+      if (link.mode == MODE_STOPWATCH && !stopwatch.isRunning()) {
+        stopwatchMode.load(0, command.rxMicros);
       }
+      //An unknown mode is ignored
+      modes.select(link.mode);
+    }
+    //If Time Mode Initiated by App, set the RTC so its second edges line up with the command
+    else if (link.type == NIXIE_LINK_TIME) {
+      rxHour = link.hour;
+      rxMin = link.min;
+      rxSec = link.sec;
+      rxMicros = command.rxMicros;
+      updateRtcFlag = true;
+      modes.select(MODE_TIME);
+    }
+    //If Countdown Mode Initiated by App, the RTC keeps its time and phase
+    else {
+      countdownMode.load(CountdownTimer::toMillis(link.hour, link.min, link.sec), command.rxMicros);
+      modes.select(MODE_COUNTDOWN);
+    }
+    //The frame staged for the next edge belongs to the mode shown before the command, the next edge writes the new one
+    frameStaged = false;
+#ifdef DEBUG_BT_LATENCY
+    cmdShown = command;
+    cmdPending = link.type == NIXIE_LINK_TIME ? 'T' : link.type == NIXIE_LINK_COUNTDOWN ? 'C' : 'M';
+#endif
+  }
+}
 
-      //If Time Mode Initiated by App...
-      if (recDataBuf[0] == 'T') {
-        //Serial.println("Time Mode Initiated");
 
-        //Set setHardwareMode to true indicating to core 1 that user has activated time mode
-        setHardwareMode = true;
+//Countdown and stopwatch expired hook, runs in nixieTask and has ledTask blink the LEDs
+void onCountdownExpired(void * /*arg*/) {
+  uint8_t alert = 1;
+  alertQueue.push(alert);
+}
 
-        //Set updateRtcFlag to alert core 1 to update the display
-        updateRtcFlag = true;
 
-        //set the timeInitFlag
-        timeInitFlag = true;
-      }
+//Queue notification, wakes the consumer task once it has been created
+void wakeTask(void *handle) {
+  TaskHandle_t task = *(TaskHandle_t *)handle;
+  if (task != NULL) {
+    xTaskNotifyGive(task);
+  }
+}
 
-      //If Countdown Mode Initiated by App...
-      else if (recDataBuf[0] == 'C') {
-        //Serial.println("Countdown Mode Initiated");
 
-        //Set setHardwareMode to false indicating to core 1 that user has activated countdown mode
-        setHardwareMode = false;
+//Records the latency of the last time, countdown or mode command once it shows on the tubes, printed with DEBUG_BT_LATENCY
+void reportCommandLatency() {
+#ifdef DEBUG_BT_LATENCY
+  if (cmdPending == 0) {
+    return;
+  }
+  char type = cmdPending;
+  cmdPending = 0;
+  Serial.printf("[BT] %c command: packet to dispatch %uus, packet to display %uus, queue high water %u overflows %u\n", type,
+                cmdShown.dispatchMicros - cmdShown.rxMicros, micros() - cmdShown.rxMicros, nixieQueue.getHighWater(), nixieQueue.getOverflows());
+#endif
+}
 
-        //Set updateRtcFlag to alert core 1 to update the display
-        updateRtcFlag = true;
 
-        //set the countdownInitFlag to run the countdownInit function once
-        countdownInitFlag = true;
-      }
+//Called by the Bluetooth stack for every packet from the app, queues the bytes and wakes btTask
+//Only the ring buffer write happens here, the stack task is not held up by parsing or the nixie flags
+void btDataCallback(const uint8_t *buffer, size_t size) {
+  btRxMicros = micros();
+  appLink.write(buffer, size);
+  xTaskNotifyGive(btTaskHandle);
+}
 
-      //If RGB LED Config Changed by App...
-      else if (recDataBuf[0] == 'L') {
-        //Serial.println("RGB LED Config");
-
-        //Format: L:A:BCD:EFG:HIJ:KLM
-        /*   A = LED Mode   = 1-8
-           B-D = Brightness = 0-100
-           E-G = R in RGB   = 0-255
-           H-J = G in RGB   = 0-255
-           K-M = B in RGB   = 0-255
-        */
-
-        //Read LED Mode
-        if (recDataBuf[2] == '1') {
-          //Mode 1 - Rainbow Cycle
-          ledModeNum = 1;
-        }
-        else if (recDataBuf[2] == '2') {
-          //Mode 2 - Breath
-          ledModeNum = 2;
-        }
-        else if (recDataBuf[2] == '3') {
-          //Mode 3 - Fade
-          ledModeNum = 3;
-        }
-        else if (recDataBuf[2] == '4') {
-          //Mode 4 - Theater Chase
-          ledModeNum = 4;
-        }
-        else if (recDataBuf[2] == '5') {
-          //Mode 5 - Theater Chase Rainbow
-          ledModeNum = 5;
-        }
-        else if (recDataBuf[2] == '6') {
-          //Mode 6 - Running Lights
-          ledModeNum = 6;
-        }
-        else if (recDataBuf[2] == '7') {
-          //Mode 7 - Merry Christmas
-          ledModeNum = 7;
-        }
-        else if (recDataBuf[2] == '8') {
-          //Mode 8 - Static
-          ledModeNum = 8;
-        }
 
-        //Read LED brightness
-        ledBrightnessVar = (String(recDataBuf[4]) + String(recDataBuf[5]) + String(recDataBuf[6])).toInt();
+/*! btTask() :: TASK
+   @brief enables bt, rx data from app, queues the commands to nixieTask and ledTask
+   @note Data arrives through btDataCallback, a command is dispatched as soon as its frame completes
+   @param void
+*/
+void btTask(void * pvParameters) {
 
-        //Read LED Color
-        redVar = (String(recDataBuf[8]) + String(recDataBuf[9]) + String(recDataBuf[10])).toInt();
-        greenVar = (String(recDataBuf[12]) + String(recDataBuf[13]) + String(recDataBuf[14])).toInt();
-        blueVar = (String(recDataBuf[16]) + String(recDataBuf[17]) + String(recDataBuf[18])).toInt();
+  //Name of BT signal
+  //This will be the name shown to other BT devices in the BT network
+  //ID is defined above and is unique to each clock (This is to prevent multiple clocks from having the same name on the BT network)
+  espBt.begin("Nixie_Clock_" + ID);
+  espBt.onData(btDataCallback);
 
-        //set updateLedFlag to alert core 1 to update the RGB LEDs
-        updateLedFlag = true;
-      }
-    }
-    //If no data is received from app and core 0 is not busy processing that data...
-    else {
+  while (1) {
+    //Sleep until the app sends data...
+    if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(150)) == 0) {
       //Slow blink comLed to indicate to user that hardware is connected to app and waiting for commands from app side
       digitalWrite(comLed, !digitalRead(comLed));
-      vTaskDelay(pdMS_TO_TICKS(150));
+      continue;
+    }
+
+    //Dispatch the commands the data completed straight away
+    //App versions that send no line ending have their command ended by a pause of btGapMs instead
+    while (!pollAppLink() && !appLink.isFramed()) {
+      if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(btGapMs)) == 0) {
+        nixie_link_command_t command;
+        if (appLink.idle(command)) {
+          queueCommand(command);
+        }
+        break;
+      }
     }
   }
 }
 
+
 /*! nixieTask() :: TASK
    @brief sets nixie tubes according to flags set by btTask and RTC time
    @note none
@@ -366,36 +520,20 @@ void nixieTask(void * pvParameters) {
   //Update RTC with current time
   //Manually write the default hour, min and sec to RTC
   //This will be the default start up time when the clock is reset
-  int defaultHour = 0;
-  int defaultMin = 0;
-  int defaultSec = 0;
-  pcf2129rtcInstance.updateCurrentTimeToRTC(defaultHour, defaultMin, defaultSec); //(HOUR,MIN,SEC)
+  TimeSnapshot defaultTime = {0, 0, 0, 1, 6, 1, 0, false}; //(SEC,MIN,HOUR,DAY,WEEKDAY,MONTH,YEAR) 00:00:00 Sat 1 Jan 2000
+  pcf2129rtcInstance.setDateTime(defaultTime, micros()); //Release straight away
 
   //Interrupt Definitions
   //attachInterrupt(digitalPinToInterrupt(PIN_NUM), ISR, mode)
   //Mode: LOW/CHANGE/RISING/FALLING/*HIGH(Only for Due,Zero,MKR1000 boards)*
   attachInterrupt(digitalPinToInterrupt(rtcInt), rtcIntISR, FALLING);
 
-  //Port expander chips config and port IO mode setting
+  //Port expander chips config (all ports as outputs) and clear all outputs, one burst each
   expanderChip0.configuration();
-  expanderChip0.portMode(0, OUTPUT); //(PORT_NUM,INPUT/OUTPUT)
-  expanderChip0.portMode(1, OUTPUT);
-  expanderChip0.portMode(2, OUTPUT);
-  expanderChip0.portMode(3, OUTPUT);
-  expanderChip0.portMode(4, OUTPUT);
+  expanderChip0.setAllClear();
 
   expanderChip1.configuration();
-  expanderChip1.portMode(0, OUTPUT);
-  expanderChip1.portMode(1, OUTPUT);
-  expanderChip1.portMode(2, OUTPUT);
-  expanderChip1.portMode(3, OUTPUT);
-  expanderChip1.portMode(4, OUTPUT);
-
-  //whats this? found it in edward's ex... cathode protection?
-  for (int i = 0 ; i < 40; i++) {
-    expanderChip0.digitalWrite(i, 0);
-    expanderChip1.digitalWrite(i, 0);
-  }
+  expanderChip1.setAllClear();
 
   display.init(); //Initialize display
   //Start Nixie Clock in time mode from 000000
@@ -403,201 +541,135 @@ void nixieTask(void * pvParameters) {
   display.write(initTime);
 
   catProInitTime = millis(); //Init catProInitTime
-  //Core 1 Config
+  //Core 0 Config
   xTaskCreatePinnedToCore(
     ledTask, //Task Function
     "LED Task",     //Name of Task
     2048,        //Stack size of task
     NULL,         //Parameter of the task
     0,            //Priority of the task
-    NULL,       //Task handle to keep track of the created task
-    tskNO_AFFINITY);           //Target Core
+    &ledTaskHandle,       //Task handle to keep track of the created task
+    0);           //Target Core, core 1 is left to nixieTask so its idle time can be measured
 
   while (1) {
+    //Block until the RTC edge or btTask notifies this task, or the next crossfade step or cathode protection is due
+    uint32_t waitMs = display.getServiceDelay();
+    uint32_t catProElapsed = millis() - catProInitTime;
+    if (catProElapsed < 600000 && 600000 - catProElapsed < waitMs) {
+      waitMs = 600000 - catProElapsed;
+    }
+    else if (catProElapsed >= 600000) {
+      waitMs = 0;
+    }
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(waitMs));
+
+    //Account the time core 1 was idle for, and publish it once a second
+    uint32_t wakeMicros = micros();
+    if (core1Idle) {
+      core1IdleAccum += wakeMicros - core1IdleStart;
+      core1Idle = false;
+    }
+    if (wakeMicros - core1IdleWindow >= 1000000) {
+      core1IdleUs = core1IdleAccum;
+      core1IdleAccum = 0;
+      core1IdleWindow = wakeMicros;
+#ifdef DEBUG_IDLE
+      Serial.printf("[NIXIE] Core 1 idle %uus/s\n", core1IdleUs);
+#endif
+    }
+
+    //Run the tube crossfades started by display.write() and any cathode protection
+    display.service();
+
     //If it has been 10mins since power on or the previous run of the cathode protection routine...
-    if (millis() - catProInitTime > 600000) {
-      //Run cathode protection and serial print result
-      display.runProtection(CATHODE_PROTECTION_STYLE_SEQUENTIAL, 5000);
+    if (millis() - catProInitTime >= 600000) {
+      //Start cathode protection in the background, display.service() runs it between the second ticks
+      display.startProtection(CATHODE_PROTECTION_STYLE_WEIGHTED, 5000);
       catProInitTime = millis(); //Reset catProInitTime to current time
     }
 
+    //Take the commands btTask queued since the last wake
+    takeNixieCommands();
+
     //If the updateRtcFlag has been set, it means that the hardware has received a command from the user
     //through the mobile app to update the display
     if (updateRtcFlag == true) {
-      //If time mode is activated by user...
-      if (setHardwareMode == true) {
-        pcf2129rtcInstance.updateCurrentTimeToRTC(rxHour, rxMin, rxSec); //(HOUR,MIN,SEC)
-      }
-      //If countdown mode is activated by user...
-      else {
-        //-1 the rxSec cuz in the time taken by the rtc to update the nixie tube... 1s has already passed!!!
-        if (rxSec > 0) {
-          pcf2129rtcInstance.updateCurrentTimeToRTC(rxHour, rxMin, rxSec - 1); //(HOUR,MIN,SEC)
-        }
-        //Boundary Conditions
-        //If rxSec is already 0, then rxSec-1 will be -1, so write 59
-        else if (rxSec == 0) {
-          if (rxMin > 0) {
-            pcf2129rtcInstance.updateCurrentTimeToRTC(rxHour, rxMin - 1, 59); //(HOUR,MIN,SEC)
-          }
-          //If rxMin and rxSec are already 0, then rxSec-1 and rxMin-1 will be -1, so write 59
-          else if (rxMin == 0) {
-            if (rxHour > 0) {
-              pcf2129rtcInstance.updateCurrentTimeToRTC(rxHour - 1, 59, 59); //(HOUR,MIN,SEC)
-            }
-          }
-        }
+      //Keep the date, only the time comes from the app
+      TimeSnapshot rxTime = {0, 0, 0, 1, 6, 1, 0, false};
+      pcf2129rtcInstance.readTimeConsistent(rxTime);
+      int rxTimeConcat = rxHour * 10000 + rxMin * 100 + rxSec;
+      //The next second starts one second after the message arrived, or a whole number of seconds later
+      //if that edge is too close to release the RTC in time. The RTC ticks PCF2129_STOP_TO_TICK_US after the release
+      unsigned long releaseMicros = rxMicros + 1000000 - PCF2129_STOP_TO_TICK_US;
+      while ((long)(releaseMicros - micros()) < 2000) {
+        releaseMicros += 1000000;
+        rxTimeConcat = nextSecond(rxTimeConcat);
       }
+      rxTime.hour = rxTimeConcat / 10000;
+      rxTime.min = (rxTimeConcat / 100) % 100;
+      rxTime.sec = rxTimeConcat % 100;
+      pcf2129rtcInstance.setDateTime(rxTime, releaseMicros);
+      frameStaged = false; //The staged second is stale now, the next edge reads the new time
       updateRtcFlag = false; //Reset the updateRtcFlag
     }
 
     //If RTC seconds interrupt triggered...
     if (secIntFlag == true) {
-      //If time mode is activated by user...
-      if (setHardwareMode == true) {
-        if (timeInitFlag) {
-          //display.clear();
-          display.write(0);
-          timeInitFlag = false;
+      //Show the frame staged before this edge, a single commit burst with no RTC access in between
+      if (frameStaged) {
+        display.commitStaged();
+#ifdef DEBUG_LATENCY
+        uint32_t latency = micros() - secIntMicros;
+        latencySum += latency;
+        if (latency > latencyMax) {
+          latencyMax = latency;
         }
-        rtcTimeConcat = (String(pcf2129rtcInstance.readRtcHourBCD1()) + String(pcf2129rtcInstance.readRtcHourBCD0()) + String(pcf2129rtcInstance.readRtcMinBCD1()) + String(pcf2129rtcInstance.readRtcMinBCD0()) + String(pcf2129rtcInstance.readRtcSecBCD1()) + String(pcf2129rtcInstance.readRtcSecBCD0())).toInt();
-        if (rtcTimeConcat != rtcTimeConcatPrev) {
-          //drive nixie
-          display.write(rtcTimeConcat);
-          rtcTimeConcatPrev = rtcTimeConcat;
+        if (++latencyCount == 60) {
+          Serial.printf("[NIXIE] RTC edge to commit latency avg %uus max %uus\n", latencySum / latencyCount, latencyMax);
+          latencySum = 0;
+          latencyMax = 0;
+          latencyCount = 0;
         }
+#endif
+      }
+      //Read the time of day for the modes, off the critical path
+      int rtcTime = readRtcTime();
+      if (rtcTime >= 0) {
+        clockSecond = hhmmssToSecond(rtcTime);
       }
-      //If countdown mode is activated by user...
       else {
-        //for later use
-        int countdownHour;
-        int countdownMin;
-        int countdownSec;
-        int countdownTime;
-        int countdownTimePrev;
-        String formattedCountdownHourString;
-        String formattedCountdownMinString;
-        String formattedCountdownSecString;
-
-        if (countdownInitFlag) {
-          //Clear tubes
-          //display.clear();
-          display.write(0);
-
-          //saving rxHour, rxMin, rxSec into vars for later use
-          countdownHour = rxHour;
-          countdownMin = rxMin;
-          countdownSec = rxSec;
-
-          int countdownInitTimePrev = 0;
-          String formattedRxHourString;
-          String formattedRxMinString;
-          String formattedRxSecString;
-          int countdownInitTime;
-
-          if (rxHour < 10) {
-            formattedRxHourString = "0" + String(rxHour);
-          }
-          else {
-            formattedRxHourString = String(rxHour);
-          }
-          if (rxMin < 10) {
-            formattedRxMinString = "0" + String(rxMin);
-          }
-          else {
-            formattedRxMinString = String(rxMin);
-          }
-          if (rxSec < 10) {
-            formattedRxSecString = "0" + String(rxSec);
-          }
-          else {
-            formattedRxSecString = String(rxSec);
-          }
-
-          countdownInitTime = (formattedRxHourString + formattedRxMinString + formattedRxSecString).toInt();
-
-          display.write(countdownInitTime);
-
-          if (countdownSec == 0) {
-            if (countdownMin == 0) {
-              if (countdownHour == 0) {
-                display.write(0);
-              } else {
-                countdownHour -= 1;
-                countdownMin = 59;
-                countdownSec = 59;
-              }
-            } else {
-              countdownMin -= 1;
-              countdownSec = 59;
-            }
-          } else {
-            countdownSec -= 1;
-          }
-
-          countdownTimePrev = countdownInitTime;
-
-          //Reset the flag so that this loop doesn't run again
-          countdownInitFlag = false;
-        } else {
-          if (countdownHour < 10) {
-            formattedCountdownHourString = "0" + String(countdownHour);
-          }
-          else {
-            formattedCountdownHourString = String(countdownHour);
-          }
-          if (countdownMin < 10) {
-            formattedCountdownMinString = "0" + String(countdownMin);
-          }
-          else {
-            formattedCountdownMinString = String(countdownMin);
-          }
-          if (countdownSec < 10) {
-            formattedCountdownSecString = "0" + String(countdownSec);
-          }
-          else {
-            formattedCountdownSecString = String(countdownSec);
-          }
-
-          countdownTime = (formattedCountdownHourString + formattedCountdownMinString + formattedCountdownSecString).toInt();
-          display.write(countdownTime);
-          //Serial.println(countdownTime);
-
-          countdownTimePrev = countdownTime;
-
-          if (countdownSec == 0) {
-            if (countdownMin == 0) {
-              if (countdownHour == 0) {
-                display.write(0);
-              } else {
-                countdownHour -= 1;
-                countdownMin = 59;
-                countdownSec = 59;
-              }
-            } else {
-              countdownMin -= 1;
-              countdownSec = 59;
-            }
-          } else {
-            countdownSec -= 1;
-          }
-        }
+        //Read failed: carry on from the last second, the next read corrects it
+        clockSecond = (clockSecond + 1) % NIXIE_MODE_DAY_S;
       }
+      //Mode switch, time was set or an edge was missed: drive nixie directly
+      if (modes.tick(clockSecond) || !frameStaged) {
+        display.write(modes.render(0));
+        reportCommandLatency();
+      }
+      //Stage the next second so the next edge only costs a commit
+      display.stage(modes.render(1));
+      frameStaged = true;
+
       //Reset interrupt secIntFlag
       secIntFlag = false;
       pcf2129rtcInstance.clearMsf();
       //Flash OpsLed to indicate rtc seconds interrupt successful triggering
       digitalWrite(opsLed, !digitalRead(opsLed));
-      vTaskDelay(pdMS_TO_TICKS(50));
     }
   }
 }
 /*! ledTask() :: TASK
-   @brief sets leds based on flag set by nixieTask and runs led service()
+   @brief sets leds from the commands btTask queues and runs led service()
    @note none
    @param void
 */
 void ledTask(void * pvParameters) {
+  //Countdown alert, the LED settings are put back when it ends
+  bool alerting = false;
+  uint32_t alertStart = 0;
+  uint8_t savedMode = 0;
+  uint32_t savedColor = 0;
+  uint8_t savedBrightness = 0;
 
   //RGB LED Config (Default Settings)
   ws2812fx.init();
@@ -606,9 +678,14 @@ void ledTask(void * pvParameters) {
   ws2812fx.setMode(FX_MODE_RAINBOW_CYCLE);
   ws2812fx.start();
   while (1) {
-    if (updateLedFlag == true) {
+    //Apply the LED commands btTask queued, the last one wins
+    app_command_t command;
+    while (ledQueue.pop(command)) {
+      const nixie_link_command_t &led = command.link;
+      alerting = false; //A command from the app ends the alert
+
       //Check and Set LED Mode
-      switch (ledModeNum) {
+      switch (led.ledMode) {
         case 1:
           //Serial.println("RGB LED set to Rainbow Mode");
           ws2812fx.setMode(FX_MODE_RAINBOW_CYCLE);
@@ -644,41 +721,67 @@ void ledTask(void * pvParameters) {
       }
 
       //Check and Set LED Brightness
-      //Serial.println("LED Brightness Set To: " + String(ledBrightnessVar));
-      ws2812fx.setBrightness(ledBrightnessVar);
+      //Serial.println("LED Brightness Set To: " + String(led.brightness));
+      ws2812fx.setBrightness(led.brightness);
 
       //Check and Set LED Color
-      //Serial.println("LED Color Set to RGB: " + String(redVar) + "," + String(greenVar) + "," + String(blueVar));
-      ws2812fx.setColor(redVar, greenVar, blueVar);
+      //Serial.println("LED Color Set to RGB: " + String(led.red) + "," + String(led.green) + "," + String(led.blue));
+      ws2812fx.setColor(led.red, led.green, led.blue);
+#ifdef DEBUG_BT_LATENCY
+      Serial.printf("[BT] L command: packet to dispatch %uus, packet to display %uus, queue high water %u overflows %u\n",
+                    command.dispatchMicros - command.rxMicros, micros() - command.rxMicros, ledQueue.getHighWater(), ledQueue.getOverflows());
+#endif
+    }
 
-      updateLedFlag = false; //Reset the updateLEDFlag
+    //Blink red when a countdown runs out, then go back to the LED settings of the app
+    uint8_t alert;
+    while (alertQueue.pop(alert)) {
+      if (!alerting) {
+        savedMode = ws2812fx.getMode();
+        savedColor = ws2812fx.getColor();
+        savedBrightness = ws2812fx.getBrightness();
+      }
+      ws2812fx.setMode(FX_MODE_BLINK);
+      ws2812fx.setColor(RED);
+      ws2812fx.setBrightness(100);
+      alerting = true;
+      alertStart = millis();
+    }
+    if (alerting && millis() - alertStart >= countdownAlertMs) {
+      ws2812fx.setMode(savedMode);
+      ws2812fx.setColor(savedColor);
+      ws2812fx.setBrightness(savedBrightness);
+      alerting = false;
     }
+
     ws2812fx.service();
-    vTaskDelay(5);
+    //Sleep until the next service, or wake early when btTask queues a command
+    ulTaskNotifyTake(pdTRUE, 5);
   }
 }
 
-//The function is required for the Nixie tube driver library
-bool platformGPIOWrite(uint8_t pin, bool data)
+//Cathode writes from the Nixie tube driver library go to the port expanders
+bool ExpanderPlatform::portWrite(uint8_t chip, uint8_t port, const uint8_t *data, uint8_t len)
 {
-
-  if (pin >= 40)
+  //A NACKed write fails the commit, which sends the same span again at the next one
+  if (chip == 0)
   {
-    pin = pin - 40;
-    expanderChip1.digitalWrite(pin, data);
-    return true;
+    return expanderChip0.writePorts(port, data, len);
   }
-  else
+  else if (chip == 1)
   {
-    expanderChip0.digitalWrite(pin, data);
-    return true;
+    return expanderChip1.writePorts(port, data, len);
   }
 
   return false;
 }
 
-//The function is required for the Nixie tube driver library
-void platformDelayMs(uint32_t ms)
+void ExpanderPlatform::delayMs(uint32_t ms)
 {
   vTaskDelay(ms);
 }
+
+uint32_t ExpanderPlatform::millis()
+{
+  return ::millis();
+}
@@ -0,0 +1,115 @@
+/**
+ @file driftestimator.cpp
+ @brief Least-squares fit of the drift of a clock against reference time samples
+ @author Edward62740
+ */
+
+#include "driftestimator.h"
+#include <math.h>
+
+DriftEstimator::DriftEstimator()
+{
+    reset();
+}
+
+/**
+ @brief Drops all samples, e.g. after the clock was set or trimmed
+ */
+void DriftEstimator::reset()
+{
+    _head = 0;
+    _count = 0;
+}
+
+/**
+ @brief Adds an offset measurement
+ @param [in] time Reference time of the measurement in s, e.g. NTP seconds, increasing from sample to sample
+ @param [in] offset Clock minus reference in ms, positive if the clock is ahead
+ */
+void DriftEstimator::addSample(uint32_t time, int32_t offset)
+{
+    _time[_head] = time;
+    _offset[_head] = offset;
+    _head = (_head + 1) % DRIFT_MAX_SAMPLES;
+    if (_count < DRIFT_MAX_SAMPLES)
+    {
+        _count++;
+    }
+}
+
+/**
+ @brief Number of samples in the fit
+ @return 0-DRIFT_MAX_SAMPLES
+ */
+uint8_t DriftEstimator::getCount()
+{
+    return _count;
+}
+
+/**
+ @brief Time between the oldest and newest sample
+ @return Span in s
+ */
+uint32_t DriftEstimator::getSpan()
+{
+    if (_count < 2)
+    {
+        return 0;
+    }
+    uint8_t oldest = (_head + DRIFT_MAX_SAMPLES - _count) % DRIFT_MAX_SAMPLES;
+    uint8_t newest = (_head + DRIFT_MAX_SAMPLES - 1) % DRIFT_MAX_SAMPLES;
+    return _time[newest] - _time[oldest];
+}
+
+/**
+ @brief Fits offset = a + drift * time through the samples
+ @param [out] ppm Drift of the clock in ppm, positive if it runs fast
+ @param [out] residual RMS distance of the samples from the line in ms, may be NULL
+ @return false if there are less than 3 samples or they span no time
+ */
+bool DriftEstimator::getDrift(float *ppm, float *residual)
+{
+    if (_count < 3)
+    {
+        return false;
+    }
+    uint8_t oldest = (_head + DRIFT_MAX_SAMPLES - _count) % DRIFT_MAX_SAMPLES;
+    // centred on the means, so the sums stay small and the times are relative to the oldest sample
+    double meanT = 0;
+    double meanO = 0;
+    for (uint8_t i = 0; i < _count; i++)
+    {
+        uint8_t n = (oldest + i) % DRIFT_MAX_SAMPLES;
+        meanT += (double)(_time[n] - _time[oldest]);
+        meanO += _offset[n];
+    }
+    meanT /= _count;
+    meanO /= _count;
+    double stt = 0;
+    double sto = 0;
+    for (uint8_t i = 0; i < _count; i++)
+    {
+        uint8_t n = (oldest + i) % DRIFT_MAX_SAMPLES;
+        double t = (double)(_time[n] - _time[oldest]) - meanT;
+        stt += t * t;
+        sto += t * (_offset[n] - meanO);
+    }
+    if (stt <= 0)
+    {
+        return false;
+    }
+    double slope = sto / stt; // ms/s
+    *ppm = (float)(slope * 1000);
+    if (residual != NULL)
+    {
+        double sum = 0;
+        for (uint8_t i = 0; i < _count; i++)
+        {
+            uint8_t n = (oldest + i) % DRIFT_MAX_SAMPLES;
+            double r = _offset[n] - meanO - slope * ((double)(_time[n] - _time[oldest]) - meanT);
+            sum += r * r;
+        }
+        *residual = (float)sqrt(sum / _count);
+    }
+    return true;
+}
@@ -0,0 +1,35 @@
+/**
+ @file driftestimator.h
+ @brief Least-squares fit of the drift of a clock against reference time samples
+ @author Edward62740
+ */
+
+#ifndef DRIFTESTIMATOR_H
+#define DRIFTESTIMATOR_H
+
+#include <Arduino.h>
+
+#define DRIFT_MAX_SAMPLES 16 // the oldest sample is dropped beyond this
+
+/**
+ @class DriftEstimator
+ @brief Keeps the offsets of a clock measured against a reference, e.g. the RTC against NTP, and fits a line through
+        them. The slope is the frequency error of the clock
+ */
+class DriftEstimator
+{
+    public:
+    DriftEstimator();
+    void reset();
+    void addSample(uint32_t time, int32_t offset);
+    uint8_t getCount();
+    uint32_t getSpan();
+    bool getDrift(float *ppm, float *residual = NULL);
+    private:
+    uint32_t _time[DRIFT_MAX_SAMPLES]; // reference time of each sample in s
+    int32_t _offset[DRIFT_MAX_SAMPLES]; // clock minus reference in ms
+    uint8_t _head; // index of the next sample to write
+    uint8_t _count;
+};
+
+#endif
@@ -53,7 +53,7 @@ void FaBoRTC_PCF2129::setSeconds(uint8_t seconds) {
   if ( seconds>59 && seconds<0 ) {
     seconds = 0;
   }
-  writeI2c(PCF2129_SECONDS, (decToBcd(seconds) + 0x80));
+  writeI2c(PCF2129_SECONDS, decToBcd(seconds)); // bit 7 clear, clears the oscillator stop flag
 }
 
 /**
@@ -181,7 +181,7 @@ DateTime FaBoRTC_PCF2129::now(void) {
   Wire.endTransmission();
   Wire.requestFrom(_i2caddr, (uint8_t)7);
   while(!Wire.available());
-  uint8_t seconds = bcdToDec(Wire.read());
+  uint8_t seconds = bcdToDec(Wire.read() & 0x7F); // bit 7 is the oscillator stop flag
   uint8_t minutes = bcdToDec(Wire.read());
   uint8_t hours = bcdToDec(Wire.read());
   uint8_t days = bcdToDec(Wire.read());
@@ -200,7 +200,7 @@ void FaBoRTC_PCF2129::setDate(uint16_t years, uint8_t months, uint8_t days,
                               uint8_t hours, uint8_t minutes, uint8_t seconds) {
   Wire.beginTransmission(_i2caddr);
   Wire.write(PCF2129_SECONDS);
-  Wire.write(decToBcd(seconds) + 0x80);
+  Wire.write(decToBcd(seconds)); // bit 7 clear, clears the oscillator stop flag
   Wire.write(decToBcd(minutes));
   Wire.write(decToBcd(hours));
   Wire.write(decToBcd(days));
@@ -210,6 +210,24 @@ void FaBoRTC_PCF2129::setDate(uint16_t years, uint8_t months, uint8_t days,
   Wire.endTransmission();
 }
 
+/**
+ @brief Set to RTC with the prescaler held in STOP, and restart it at a given time so the next seconds increment
+        lands PCF2129_STOP_TO_TICK_US later, on a known second edge
+ @param [in] DateTime DateTime
+ @param [in] releaseMicros micros() to clear STOP at, at most a few seconds ahead
+*/
+void FaBoRTC_PCF2129::setDate(uint16_t years, uint8_t months, uint8_t days,
+                              uint8_t hours, uint8_t minutes, uint8_t seconds, uint32_t releaseMicros) {
+  uint8_t ctrl = readCtrl() & ~PCF2129_CONTROL_STOP;
+  writeCtrl(ctrl | PCF2129_CONTROL_STOP);
+  setDate(years, months, days, hours, minutes, seconds);
+  while ((int32_t)(releaseMicros - micros()) > 2000) {
+    delay(1);
+  }
+  while ((int32_t)(releaseMicros - micros()) > 0);
+  writeCtrl(ctrl);
+}
+
 /**
  @brief Set to 12 hour mode
 */
@@ -230,6 +248,33 @@ void FaBoRTC_PCF2129::set24mode(void) {
   writeCtrl(ctrl);
 }
 
+/**
+ @brief Pulse the interrupt pin low at every seconds increment
+*/
+void FaBoRTC_PCF2129::enableSecondInterrupt(void) {
+  writeI2c(PCF2129_WATCHDG_TIM_CTL, PCF2129_WATCHDG_TI_TP); // pulsed, so the flag needs no clearing
+  writeCtrl(readCtrl() | PCF2129_CONTROL_SI);
+}
+
+/**
+ @brief Get the Aging Offset from RTC
+ @param [out] offset PCF2129_AGING_OFFSET_ZERO +- ppm the clock is slowed by
+*/
+uint8_t FaBoRTC_PCF2129::getAgingOffset(void) {
+  return readI2c(PCF2129_AGING_OFFSET) & 0x0F;
+}
+
+/**
+ @brief Set the Aging Offset to RTC
+ @param [in] offset 0 (+8ppm) to 15 (-7ppm), PCF2129_AGING_OFFSET_ZERO for no correction
+*/
+void FaBoRTC_PCF2129::setAgingOffset(uint8_t offset) {
+  if ( offset>15 ) {
+    offset = 15;
+  }
+  writeI2c(PCF2129_AGING_OFFSET, offset);
+}
+
 ////////////////////////////////////////////////////////////////
 
 /**
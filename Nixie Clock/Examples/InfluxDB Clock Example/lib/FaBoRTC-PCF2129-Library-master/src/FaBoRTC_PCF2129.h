@@ -23,6 +23,10 @@
 /// @{
 #define PCF2129_CONTROL_REGISTERS 0x00
 #define PCF2129_CONTROL_12_24 0x04
+#define PCF2129_CONTROL_SI 0x01
+#define PCF2129_CONTROL_STOP 0x20
+#define PCF2129_WATCHDG_TIM_CTL 0x10
+#define PCF2129_WATCHDG_TI_TP 0x20
 #define PCF2129_SECONDS 0x03
 #define PCF2129_MINUTES 0x04
 #define PCF2129_HOURS 0x05
@@ -30,8 +34,12 @@
 #define PCF2129_WEEKDAYS 0x07
 #define PCF2129_MONTHS 0x08
 #define PCF2129_YEARS 0x09
+#define PCF2129_AGING_OFFSET 0x19
 /// @}
 
+#define PCF2129_STOP_TO_TICK_US 507813 ///< Clearing STOP to the first seconds increment, in us
+#define PCF2129_AGING_OFFSET_ZERO 8 ///< Aging offset of 0ppm, each step up slows the clock by 1ppm, 0-15
+
 /**
  @class DateTime
  @brief RTC DateTime class
@@ -76,8 +84,13 @@ class FaBoRTC_PCF2129 {
     DateTime now(void);
     void setDate(uint16_t years, uint8_t months, uint8_t days,
                  uint8_t hours, uint8_t minutes, uint8_t seconds);
+    void setDate(uint16_t years, uint8_t months, uint8_t days,
+                 uint8_t hours, uint8_t minutes, uint8_t seconds, uint32_t releaseMicros);
     void set12mode(void);
     void set24mode(void);
+    void enableSecondInterrupt(void);
+    uint8_t getAgingOffset(void);
+    void setAgingOffset(uint8_t offset);
   private:
     uint8_t _i2caddr;
     uint8_t bcdToDec(uint8_t value);
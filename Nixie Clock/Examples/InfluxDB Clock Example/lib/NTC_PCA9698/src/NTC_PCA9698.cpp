@@ -15,28 +15,16 @@
 */
 PCA9698::PCA9698(uint8_t addr, int pin_SDA, int pin_SCL, uint32_t bus_speed) {
   _i2caddr = addr;
-  _output_port0 = 0x00;
-  _output_port1 = 0x00;
-  _output_port2 = 0x00;
-  _output_port3 = 0x00;
-  _output_port4 = 0x00;
+  memset(_output_port, 0x00, sizeof(_output_port));
   Wire.begin(pin_SDA,pin_SCL,bus_speed);
 }
 
 /**
- @brief Configure device
+ @brief Configure device, all ports set as outputs
 */
 void PCA9698::configuration() {
-  Wire.beginTransmission(_i2caddr);
-  Wire.write(PCA9698_CONFIG_PORT0);
-  byte mode[5];
-  mode[0] = 0x00;
-  mode[1] = 0x00;
-  mode[2] = 0x00;
-  mode[3] = 0x00;
-  mode[4] = 0x00;
-  Wire.write(mode, sizeof(mode));
-  Wire.endTransmission();
+  const byte mode[PCA9698_PORT_COUNT] = {OUTPUT, OUTPUT, OUTPUT, OUTPUT, OUTPUT};
+  setPortModes(mode);
 }
 
 /**
@@ -47,43 +35,86 @@ void PCA9698::configuration() {
 void PCA9698::digitalWrite(uint8_t pin, uint8_t output) {
   if(8 > pin && pin >=0) {
     if (output == HIGH) {
-      _output_port0 |= 1<<pin;
+      _output_port[0] |= 1<<pin;
     } else if (output == LOW){
-      _output_port0 &= ~(1<<pin);
+      _output_port[0] &= ~(1<<pin);
     }
-    writeI2c(PCA9698_OUTPUT_PORT0, _output_port0);
+    writeI2c(PCA9698_OUTPUT_PORT0, _output_port[0]);
   } else if(16 > pin && pin >= 8) {
     if (output == HIGH) {
-      _output_port1 |= 1<<(pin - 8);
+      _output_port[1] |= 1<<(pin - 8);
     } else if (output == LOW){
-      _output_port1 &= ~(1<<(pin - 8));
+      _output_port[1] &= ~(1<<(pin - 8));
     }
-    writeI2c(PCA9698_OUTPUT_PORT1, _output_port1);
+    writeI2c(PCA9698_OUTPUT_PORT1, _output_port[1]);
   } else if(24 > pin && pin >= 16) {
     if (output == HIGH) {
-      _output_port2 |= 1<<(pin - 16);
+      _output_port[2] |= 1<<(pin - 16);
     } else if (output == LOW){
-      _output_port2 &= ~(1<<(pin - 16));
+      _output_port[2] &= ~(1<<(pin - 16));
     }
-    writeI2c(PCA9698_OUTPUT_PORT2, _output_port2);
+    writeI2c(PCA9698_OUTPUT_PORT2, _output_port[2]);
   } else if(32 > pin && pin >= 24) {
     if (output == HIGH) {
-      _output_port3 |= 1<<(pin - 24);
+      _output_port[3] |= 1<<(pin - 24);
     } else if (output == LOW){
-      _output_port3 &= ~(1<<(pin - 24));
+      _output_port[3] &= ~(1<<(pin - 24));
     }
-    writeI2c(PCA9698_OUTPUT_PORT3, _output_port3);
+    writeI2c(PCA9698_OUTPUT_PORT3, _output_port[3]);
   } else if(40 > pin && pin >= 32) {
     if (output == HIGH) {
-      _output_port4 |= 1<<(pin - 32);
+      _output_port[4] |= 1<<(pin - 32);
     } else if (output == LOW){
-      _output_port4 &= ~(1<<(pin - 32));
+      _output_port[4] &= ~(1<<(pin - 32));
     }
-    writeI2c(PCA9698_OUTPUT_PORT4, _output_port4);
+    writeI2c(PCA9698_OUTPUT_PORT4, _output_port[4]);
  }
 
 }
 
+/**
+ @brief Write consecutive output ports in one auto-increment transaction
+ @param [in] port  first port 0-4
+ @param [in] data  output state of each port, one byte per port
+ @param [in] num  number of ports to write
+ @return true if the expander acknowledged the write
+*/
+bool PCA9698::writePorts(uint8_t port, const uint8_t * data, uint8_t num) {
+  if(port >= PCA9698_PORT_COUNT || num == 0 || num > PCA9698_PORT_COUNT - port) {
+    return false;
+  }
+  memcpy(&_output_port[port], data, num);
+  return writeI2c(PCA9698_OUTPUT_PORT0 + port, &_output_port[port], num) == 0;
+}
+
+/**
+ @brief Write all five output ports in one auto-increment transaction
+ @param [in] data  output state of ports 0-4
+*/
+void PCA9698::writeAllPorts(const uint8_t data[PCA9698_PORT_COUNT]) {
+  writePorts(0, data, PCA9698_PORT_COUNT);
+}
+
+/**
+ @brief Read all five input ports in one auto-increment transaction
+ @param [out] data  input state of ports 0-4
+*/
+void PCA9698::readAllPorts(uint8_t data[PCA9698_PORT_COUNT]) {
+  readI2c(PCA9698_INPUT_PORT0, PCA9698_PORT_COUNT, data);
+}
+
+/**
+ @brief Set the direction of all five ports in one auto-increment transaction
+ @param [in] modes  INPUT or OUTPUT for ports 0-4
+*/
+void PCA9698::setPortModes(const uint8_t modes[PCA9698_PORT_COUNT]) {
+  uint8_t config[PCA9698_PORT_COUNT];
+  for(uint8_t port = 0; port < PCA9698_PORT_COUNT; port++) {
+    config[port] = (modes[port] == INPUT) ? 0xff : 0x00;
+  }
+  writeI2c(PCA9698_CONFIG_PORT0, config, PCA9698_PORT_COUNT);
+}
+
 /**
  @brief GPIO read mode
  @param [in] pin  PCA9698 pin
@@ -137,16 +168,8 @@ int PCA9698::digitalRead(uint8_t pin) {
  @brief Reset all pins to LOW
 */
 void PCA9698::setAllClear() {
-  writeI2c(PCA9698_OUTPUT_PORT0, 0x00);
-  _output_port0 = 0x00;
-  writeI2c(PCA9698_OUTPUT_PORT1, 0x00);
-  _output_port1 = 0x00;
-  writeI2c(PCA9698_OUTPUT_PORT2, 0x00);
-  _output_port2 = 0x00;
-  writeI2c(PCA9698_OUTPUT_PORT3, 0x00);
-  _output_port3 = 0x00;
-  writeI2c(PCA9698_OUTPUT_PORT4, 0x00);
-  _output_port4 = 0x00;
+  const uint8_t data[PCA9698_PORT_COUNT] = {0x00, 0x00, 0x00, 0x00, 0x00};
+  writeAllPorts(data);
 }
 
 /**
@@ -202,6 +225,20 @@ void PCA9698::writeI2c(uint8_t address, uint8_t data) {
   Wire.endTransmission();
 }
 
+/**
+ @brief Write I2C with auto-increment
+ @param [in] address  first register address
+ @param [in] data  write data
+ @param [in] num  write length
+ @return endTransmission() status, 0 on success
+*/
+uint8_t PCA9698::writeI2c(uint8_t address, const uint8_t * data, uint8_t num) {
+  Wire.beginTransmission(_i2caddr);
+  Wire.write(address | PCA9698_AUTO_INCREMENT);
+  Wire.write(data, num);
+  return Wire.endTransmission();
+}
+
 /**
  @brief Read I2C
  @param [in] address  register address
@@ -210,11 +247,11 @@ void PCA9698::writeI2c(uint8_t address, uint8_t data) {
 */
 void PCA9698::readI2c(uint8_t address, uint8_t num, uint8_t * data) {
   Wire.beginTransmission(_i2caddr);
-  Wire.write(address);
+  Wire.write(num > 1 ? (address | PCA9698_AUTO_INCREMENT) : address);
   Wire.endTransmission();
   uint8_t i = 0;
   Wire.requestFrom(_i2caddr, num);
-  while( Wire.available() ) {
+  while( Wire.available() && i < num ) {
     data[i++] = Wire.read();
   }
 }
@@ -89,52 +89,147 @@ bool NTPClient::forceUpdate() {
     Serial.println("Update from NTP Server");
   #endif
 
-  this->sendNTPPacket();
-
-  // Wait till data is there or timeout...
-  byte timeout = 0;
-  int cb = 0;
-  do {
-    delay ( 10 );
-    cb = this->_udp->parsePacket();
-    
-    if(cb > 0)
-    {
-      this->_udp->read(this->_packetBuffer, NTP_PACKET_SIZE);
-      if(!this->isValid(this->_packetBuffer))
-        cb = 0;
-    }
-    
-    if (timeout > 100) return false; // timeout after 1000 ms
-    timeout++;
-  } while (cb == 0);
+  this->startUpdate();
 
-  this->_lastUpdate = millis() - (10 * (timeout + 1)); // Account for delay in reading the time
+  // Wait till the round is over
+  NTPPollResult result;
+  while ((result = this->poll()) == NTP_POLL_WAITING) {
+    delay ( 1 );
+  }
 
-  unsigned long highWord = word(this->_packetBuffer[40], this->_packetBuffer[41]);
-  unsigned long lowWord = word(this->_packetBuffer[42], this->_packetBuffer[43]);
-  // combine the four bytes (two words) into a long integer
-  // this is NTP time (seconds since Jan 1 1900):
-  unsigned long secsSince1900 = highWord << 16 | lowWord;
+  return result == NTP_POLL_UPDATED;
+}
 
-  this->_currentEpoc = secsSince1900 - SEVENZYYEARS;
+bool NTPClient::update() {
+  if (!this->_waiting
+    && (this->_stats.rounds == 0 || millis() - this->_roundStart >= this->_timeout) // Retry a failed round after the timeout
+    && ((millis() - this->_lastUpdate >= this->_updateInterval)   // Update after _updateInterval
+    || this->_lastUpdate == 0)) {                               // Update if there was no update yet.
+    if (!this->_udpSetup) this->begin();                         // setup the UDP client if needed
+    this->startUpdate();
+  }
+  this->poll();
+  return !this->_failed;
+}
 
+bool NTPClient::addServer(const char* poolServerName) {
+  if (this->_serverCount >= NTP_MAX_SERVERS) return false;
+  this->_servers[this->_serverCount++].name = poolServerName;
   return true;
 }
 
-bool NTPClient::update() {
-  if ((millis() - this->_lastUpdate >= this->_updateInterval)     // Update after _updateInterval
-    || this->_lastUpdate == 0) {                                // Update if there was no update yet.
-    if (!this->_udpSetup) this->begin();                         // setup the UDP client if needed
-    return this->forceUpdate();
+bool NTPClient::startUpdate() {
+  if (this->_waiting) return false;
+
+  this->_round++;
+  this->_roundStart = millis();
+  for (uint8_t i = 0; i < this->_serverCount; i++) {
+    this->sendNTPPacket(i);
   }
+  this->_waiting = true;
   return true;
 }
 
+NTPPollResult NTPClient::poll() {
+  if (!this->_waiting) return NTP_POLL_IDLE;
+
+  this->receiveNTPPackets();
+
+  bool pending = false;
+  for (uint8_t i = 0; i < this->_serverCount; i++) {
+    pending |= this->_servers[i].pending;
+  }
+  if (pending && millis() - this->_roundStart < this->_timeout) return NTP_POLL_WAITING;
+
+  return this->finishRound();
+}
+
+void NTPClient::receiveNTPPackets() {
+  // Drain whatever has arrived, parsePacket() returns 0 straight away if nothing has
+  while (this->_udp->parsePacket() > 0) {
+    unsigned long received = millis();
+    if (this->_udp->read(this->_packetBuffer, NTP_PACKET_SIZE) < NTP_PACKET_SIZE) continue;
+    if (!this->isValid(this->_packetBuffer)) continue;
+
+    // The server echoes our transmit timestamp as the originate timestamp, this matches the reply to its request
+    // and drops late replies from earlier rounds
+    for (uint8_t i = 0; i < this->_serverCount; i++) {
+      NTPServer& server = this->_servers[i];
+      if (!server.pending || memcmp(server.stamp, this->_packetBuffer + 24, 8) != 0) continue;
+
+      // T1 and T4 are our send and receive times, T2 and T3 the server's receive and transmit times.
+      // The server clock is taken to be in the middle of the network part of the round trip, so at T4 it reads
+      // (T2 + T3) / 2 + (T4 - T1) / 2. Only T4 - T1 is taken on our clock, which keeps millis() wrapping out of it
+      uint64_t serverReceive  = ntpToMillis(this->_packetBuffer + 32);
+      uint64_t serverTransmit = ntpToMillis(this->_packetBuffer + 40);
+      unsigned long roundTrip = received - server.sent;
+      unsigned long hold      = serverTransmit > serverReceive ? serverTransmit - serverReceive : 0;
+
+      server.epoch    = (serverReceive + serverTransmit + roundTrip) / 2;
+      server.received = received;
+      server.delay    = roundTrip > hold ? roundTrip - hold : 0;
+      server.pending  = false;
+      server.replied  = true;
+      this->_stats.replies++;
+      break;
+    }
+  }
+}
+
+NTPPollResult NTPClient::finishRound() {
+  int8_t best = -1;
+  for (uint8_t i = 0; i < this->_serverCount; i++) {
+    NTPServer& server = this->_servers[i];
+    if (server.pending) {
+      server.pending = false;
+      this->_stats.timeouts++;
+    }
+    if (!server.replied) continue;
+    server.replied = false;
+    if (server.delay < this->_stats.minDelay) this->_stats.minDelay = server.delay;
+    if (server.delay > this->_stats.maxDelay) this->_stats.maxDelay = server.delay;
+    // The reply with the shortest round trip has the least room for asymmetric delay
+    if (best < 0 || server.delay < this->_servers[best].delay) best = i;
+  }
+
+  this->_waiting = false;
+  this->_stats.rounds++;
+  this->_failed = best < 0;
+  if (this->_failed) {
+    this->_stats.failures++;
+    return NTP_POLL_FAILED;
+  }
+
+  NTPServer& server = this->_servers[best];
+  if (this->_lastUpdate != 0) {
+    uint64_t estimate = (uint64_t)this->_currentEpoc * 1000 + this->_currentMillis + (server.received - this->_lastUpdate);
+    this->_stats.offset = (long)(int64_t)(server.epoch - estimate);
+  }
+  this->_stats.delay  = server.delay;
+  this->_stats.server = best;
+
+  this->_currentEpoc   = server.epoch / 1000;
+  this->_currentMillis = server.epoch % 1000;
+  this->_lastUpdate    = server.received;
+  return NTP_POLL_UPDATED;
+}
+
+void NTPClient::setTimeout(unsigned long timeout) {
+  this->_timeout = timeout;
+}
+
+const NTPStats& NTPClient::getStats() const {
+  return this->_stats;
+}
+
 unsigned long NTPClient::getEpochTime() {
-  return this->_timeOffset + // User offset
-         this->_currentEpoc + // Epoc returned by the NTP server
-         ((millis() - this->_lastUpdate) / 1000); // Time since last update
+  return this->getEpochMillis() / 1000;
+}
+
+uint64_t NTPClient::getEpochMillis() {
+  return (int64_t)this->_timeOffset * 1000 + // User offset
+         (uint64_t)this->_currentEpoc * 1000 + this->_currentMillis + // Epoc returned by the NTP server
+         (millis() - this->_lastUpdate); // Time since last update
 }
 
 int NTPClient::getDay() {
@@ -205,7 +300,8 @@ void NTPClient::setUpdateInterval(unsigned long updateInterval) {
   this->_updateInterval = updateInterval;
 }
 
-void NTPClient::sendNTPPacket() {
+void NTPClient::sendNTPPacket(uint8_t server) {
+  NTPServer& target = this->_servers[server];
   // set all bytes in the buffer to 0
   memset(this->_packetBuffer, 0, NTP_PACKET_SIZE);
   // Initialize values needed to form NTP request
@@ -220,13 +316,35 @@ void NTPClient::sendNTPPacket() {
   this->_packetBuffer[14]  = 0x49;
   this->_packetBuffer[15]  = 0x52;
 
+  // The transmit timestamp only has to be unique, it carries the send time, the round and the server
+  target.sent = millis();
+  target.stamp[0] = target.sent >> 24;
+  target.stamp[1] = target.sent >> 16;
+  target.stamp[2] = target.sent >> 8;
+  target.stamp[3] = target.sent;
+  target.stamp[4] = this->_round >> 8;
+  target.stamp[5] = this->_round;
+  target.stamp[6] = server;
+  target.stamp[7] = 0x01;
+  memcpy(this->_packetBuffer + 40, target.stamp, 8);
+
   // all NTP fields have been given values, now
   // you can send a packet requesting a timestamp:
-  this->_udp->beginPacket(this->_poolServerName, 123); //NTP requests are to port 123
+  const char* name = server ? target.name : this->_poolServerName;
+  this->_udp->beginPacket(name, 123); //NTP requests are to port 123
   this->_udp->write(this->_packetBuffer, NTP_PACKET_SIZE);
-  this->_udp->endPacket();
+  target.pending = this->_udp->endPacket() == 1;
+  target.replied = false;
 }
 
 void NTPClient::setEpochTime(unsigned long secs) {
-  this->_currentEpoc = secs;
+  this->_currentEpoc   = secs;
+  this->_currentMillis = 0;
+}
+
+uint64_t NTPClient::ntpToMillis(const byte * timestamp) {
+  // 32 bits of seconds since Jan 1 1900 and 32 bits of fraction of a second
+  unsigned long secsSince1900 = (unsigned long)word(timestamp[0], timestamp[1]) << 16 | word(timestamp[2], timestamp[3]);
+  unsigned long fraction = (unsigned long)word(timestamp[4], timestamp[5]) << 16 | word(timestamp[6], timestamp[7]);
+  return (uint64_t)(secsSince1900 - SEVENZYYEARS) * 1000 + (((uint64_t)fraction * 1000) >> 32);
 }
@@ -7,8 +7,35 @@
 #define SEVENZYYEARS 2208988800UL
 #define NTP_PACKET_SIZE 48
 #define NTP_DEFAULT_LOCAL_PORT 1337
+#define NTP_MAX_SERVERS 4
+#define NTP_DEFAULT_TIMEOUT 1000 // ms to collect the replies of one update round
 #define LEAP_YEAR(Y)     ( (Y>0) && !(Y%4) && ( (Y%100) || !(Y%400) ) )
 
+/**
+ * Result of NTPClient::poll()
+ */
+enum NTPPollResult {
+  NTP_POLL_IDLE,     // no update round running
+  NTP_POLL_WAITING,  // requests sent, replies still outstanding
+  NTP_POLL_UPDATED,  // round finished, the time was updated from the reply with the lowest round trip
+  NTP_POLL_FAILED    // round timed out without a valid reply
+};
+
+/**
+ * Offset and delay statistics, see NTPClient::getStats()
+ */
+struct NTPStats {
+  unsigned long rounds   = 0;  // update rounds finished
+  unsigned long failures = 0;  // rounds without a valid reply
+  unsigned long replies  = 0;  // valid replies received
+  unsigned long timeouts = 0;  // requests that got no reply within the round
+  long          offset   = 0;  // ms the time moved by at the last update
+  unsigned long delay    = 0;  // round trip in ms of the reply used for the last update, less the server hold time
+  unsigned long minDelay = (unsigned long)-1;  // lowest round trip seen in ms, all ones until the first reply
+  unsigned long maxDelay = 0;  // highest round trip seen in ms
+  uint8_t       server   = 0;  // index of the server used for the last update
+};
+
 
 class NTPClient {
   private:
@@ -22,11 +49,35 @@ class NTPClient {
     unsigned long _updateInterval = 60000;  // In ms
 
     unsigned long _currentEpoc    = 0;      // In s
+    unsigned long _currentMillis  = 0;      // In ms past _currentEpoc
     unsigned long _lastUpdate     = 0;      // In ms
 
     byte          _packetBuffer[NTP_PACKET_SIZE];
 
-    void          sendNTPPacket();
+    struct NTPServer {
+      const char*   name     = nullptr;
+      byte          stamp[8] = {};   // transmit timestamp of the request, echoed back as the originate timestamp
+      unsigned long sent     = 0;    // millis() when the request went out
+      unsigned long received = 0;    // millis() when the reply was read
+      unsigned long delay    = 0;    // round trip of the reply in ms, less the time the server held it
+      uint64_t      epoch    = 0;    // ms since Jan. 1, 1970 when the reply was read
+      bool          pending  = false; // request sent, no reply yet
+      bool          replied  = false; // valid reply this round
+    };
+
+    NTPServer     _servers[NTP_MAX_SERVERS];
+    uint8_t       _serverCount    = 1;
+    bool          _waiting        = false;  // update round running
+    bool          _failed         = false;  // last update round got no valid reply
+    unsigned long _roundStart     = 0;      // In ms
+    unsigned long _timeout        = NTP_DEFAULT_TIMEOUT;
+    uint16_t      _round          = 0;
+    NTPStats      _stats;
+
+    void          sendNTPPacket(uint8_t server);
+    void          receiveNTPPackets();
+    NTPPollResult finishRound();
+    static uint64_t ntpToMillis(const byte * timestamp);
     bool          isValid(byte * ntpPacket);
 
   public:
@@ -48,19 +99,51 @@ class NTPClient {
 
     /**
      * This should be called in the main loop of your application. By default an update from the NTP Server is only
-     * made every 60 seconds. This can be configured in the NTPClient constructor.
+     * made every 60 seconds. This can be configured in the NTPClient constructor. Never blocks, the update round
+     * started here is completed by the following calls.
      *
-     * @return true on success, false on failure
+     * @return false if the last update round failed
      */
     bool update();
 
     /**
-     * This will force the update from the NTP Server.
+     * This will force the update from the NTP Server. Blocks for up to the round timeout, use startUpdate() and poll()
+     * to update without blocking.
      *
      * @return true on success, false on failure
      */
     bool forceUpdate();
 
+    /**
+     * Adds a server to query in every update round, next to the one given in the constructor
+     *
+     * @return false if NTP_MAX_SERVERS are already set
+     */
+    bool addServer(const char* poolServerName);
+
+    /**
+     * Sends a request to every server and returns straight away. Replies are collected by poll()
+     *
+     * @return false if a round is already running
+     */
+    bool startUpdate();
+
+    /**
+     * Reads any replies that have arrived, never blocks. The round ends when every server has replied or the
+     * timeout has passed, and the reply with the lowest round trip is used.
+     */
+    NTPPollResult poll();
+
+    /**
+     * Sets the time one update round waits for replies, in ms
+     */
+    void setTimeout(unsigned long timeout);
+
+    /**
+     * @return offset and delay statistics of the update rounds so far
+     */
+    const NTPStats& getStats() const;
+
     int getDay();
     int getHours();
     int getMinutes();
@@ -86,6 +169,11 @@ class NTPClient {
      * @return time in seconds since Jan. 1, 1970
      */
     unsigned long getEpochTime();
+
+    /**
+     * @return time in milliseconds since Jan. 1, 1970, including the time offset
+     */
+    uint64_t getEpochMillis();
   
     /**
     * @return secs argument (or 0 for current date) formatted to ISO 8601
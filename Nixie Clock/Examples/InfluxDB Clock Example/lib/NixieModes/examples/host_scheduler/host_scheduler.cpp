@@ -0,0 +1,162 @@
+/**
+ @file host_scheduler.cpp
+ @brief Runs NixieModeScheduler through a simulated day of second edges with a timetable and commands, checks which
+        mode is shown at every edge, that hidden modes keep ticking, that a running timer switched away and back loses
+        no second, and counts the renders and writes a tick costs
+ @note Build and run from this folder:
+       g++ -std=gnu++14 -O2 -I../.. host_scheduler.cpp ../../nixiemodes.cpp -o host_scheduler && ./host_scheduler
+ */
+
+#include <stdio.h>
+#include "nixiemodes.h"
+
+/* Shows its number in the top digit and counts what the scheduler asks of it */
+class CountingMode : public NixieMode
+{
+    public:
+    uint32_t id;
+    uint32_t enters;
+    uint32_t ticks;
+    uint32_t renders;
+    uint32_t second;
+    explicit CountingMode(uint32_t n) : id(n), enters(0), ticks(0), renders(0), second(0) {}
+    void enter(uint32_t now)
+    {
+        enters++;
+        second = now;
+    }
+    bool onTick(uint32_t now)
+    {
+        ticks++;
+        // a clock that was set: the edge is not the second after the last one
+        bool stale = now != (second + 1) % NIXIE_MODE_DAY_S;
+        second = now;
+        return stale;
+    }
+    uint32_t render(uint32_t ahead)
+    {
+        renders++;
+        return id * 100000 + (second + ahead) % NIXIE_MODE_DAY_S % 100000;
+    }
+};
+
+/* A stopwatch like TimerMode of the App Clock: started by a command, only steps in onTick() */
+class RunningMode : public CountingMode
+{
+    public:
+    bool load;
+    uint32_t elapsed;
+    explicit RunningMode(uint32_t n) : CountingMode(n), load(false), elapsed(0) {}
+    void enter(uint32_t now)
+    {
+        CountingMode::enter(now);
+        if (load)
+        {
+            load = false;
+            elapsed = 0;
+        }
+    }
+    bool onTick(uint32_t now)
+    {
+        CountingMode::onTick(now);
+        elapsed++;
+        return false;
+    }
+    uint32_t render(uint32_t ahead)
+    {
+        renders++;
+        return id * 100000 + (elapsed + ahead) % 100000;
+    }
+};
+
+static CountingMode timeMode(0), dateMode(2), sensorMode(3);
+static RunningMode countdownMode(1);
+static NixieMode *const modes[] = {&timeMode, &countdownMode, &dateMode, &sensorMode};
+
+/* The sensor from 22:00 to 22:10, and otherwise the date at seconds 30-32 of every minute and the sensor at 33-35 of
+   every 5th, the first slot that covers a second wins */
+static const nixie_mode_slot_t timetable[] = {
+    {86400, 22 * 3600, 600, 3},
+    {60, 30, 3, 2},
+    {300, 33, 3, 3},
+    {60, 50, 2, 9}, // no such mode, ignored
+};
+
+/* The mode each edge should show, with a countdown command at 12:00:31 and a time command at 18:00:00. The timetable
+   switches away from the running countdown and back every minute in between */
+static uint8_t expected(uint32_t s)
+{
+    if (s >= 22 * 3600 && s < 22 * 3600 + 600)
+    {
+        return 3;
+    }
+    if (s % 60 >= 30 && s % 60 < 33 && !(s >= 12 * 3600 + 31 && s < 18 * 3600 && s % 60 < 33 && s / 60 == 12 * 60))
+    {
+        return 2;
+    }
+    if (s % 300 >= 33 && s % 300 < 36)
+    {
+        return 3;
+    }
+    return s >= 12 * 3600 + 31 && s < 18 * 3600 ? 1 : 0;
+}
+
+int main()
+{
+    NixieModeScheduler scheduler(modes, 4);
+    scheduler.setTimetable(timetable, sizeof(timetable) / sizeof(timetable[0]));
+    uint32_t wrong = 0;
+    uint32_t stale = 0;
+    uint32_t switches = 0;
+    uint32_t frameErrors = 0;
+    uint32_t staged = 0;
+    bool rejected = !scheduler.select(4);
+    for (uint32_t s = 0; s < NIXIE_MODE_DAY_S; s++)
+    {
+        if (s == 12 * 3600 + 31)
+        {
+            countdownMode.load = true;
+            scheduler.select(1); // during the date slot, which it ends
+        }
+        if (s == 18 * 3600)
+        {
+            scheduler.select(0);
+        }
+        uint8_t before = scheduler.getMode();
+        bool write = scheduler.tick(s);
+        uint32_t frame = write ? scheduler.render(0) : staged;
+        if (write)
+        {
+            stale++;
+        }
+        if (scheduler.getMode() != before)
+        {
+            switches++;
+        }
+        if (scheduler.getMode() != expected(s))
+        {
+            wrong++;
+        }
+        // what is on the tubes after the edge is the frame of the mode shown at this second
+        uint32_t shown = scheduler.getMode() == 1 ? s - (12 * 3600 + 31) : s;
+        if (frame != scheduler.getMode() * 100000 + shown % 100000)
+        {
+            frameErrors++;
+        }
+        staged = scheduler.render(1);
+    }
+    uint32_t renders = 0;
+    uint32_t missedTicks = 0;
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        // every edge ticks every mode, shown, hidden or entered
+        const CountingMode *mode = (const CountingMode *)modes[i];
+        renders += mode->renders;
+        missedTicks += NIXIE_MODE_DAY_S - mode->ticks;
+    }
+    printf("%u edges, %u switches, %u stale writes, %u wrong modes, %u wrong frames, bad mode %s\n", (unsigned)NIXIE_MODE_DAY_S,
+           (unsigned)switches, (unsigned)stale, (unsigned)wrong, (unsigned)frameErrors, rejected ? "rejected" : "ACCEPTED");
+    printf("%.4f renders per edge, %u enters, %u edges a mode missed\n", (double)renders / NIXIE_MODE_DAY_S,
+           (unsigned)(timeMode.enters + countdownMode.enters + dateMode.enters + sensorMode.enters), (unsigned)missedTicks);
+    return wrong || frameErrors || missedTicks || !rejected ? 1 : 0;
+}
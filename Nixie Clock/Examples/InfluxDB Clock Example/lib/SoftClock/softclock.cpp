@@ -0,0 +1,214 @@
+/**
+ @file softclock.cpp
+ @brief Software clock on esp_timer, disciplined against the second edges of an RTC
+ @author Edward62740
+ */
+
+#include "softclock.h"
+
+SoftClock::SoftClock()
+{
+    _mux = portMUX_INITIALIZER_UNLOCKED;
+    _timer = NULL;
+    _task = NULL;
+    _set = false;
+    _ref = 0;
+    _refTime = 0;
+    _slew = 0;
+    _freq = 0;
+    _lastEdge = 0;
+    _offset = 0;
+}
+
+/**
+ @brief Starts the clock and its second edges
+ @param [in] task Task to notify with xTaskNotifyGive() at every second edge of the clock
+ @return true if the edge timer was started
+ @note The clock runs from 00:00:00 until the first discipline()
+ */
+bool SoftClock::begin(TaskHandle_t task)
+{
+    esp_timer_create_args_t args = {};
+    args.callback = onTimerInternal;
+    args.arg = this;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "softclock";
+    _task = task;
+    _ref = esp_timer_get_time();
+    if (esp_timer_create(&args, &_timer) != ESP_OK)
+    {
+        return false;
+    }
+    armInternal();
+    return true;
+}
+
+/**
+ @brief Checks if the clock has been set by discipline()
+ @return true once the clock follows the RTC
+ */
+bool SoftClock::isSet()
+{
+    return _set;
+}
+
+/**
+ @brief Current clock time
+ @return Time in us, as seconds of day times 10^6 plus the number of days run, only meaningful modulo a day
+ */
+int64_t SoftClock::now()
+{
+    portENTER_CRITICAL(&_mux);
+    int64_t time = atInternal(esp_timer_get_time(), NULL);
+    portEXIT_CRITICAL(&_mux);
+    return time;
+}
+
+/**
+ @brief Current second of the day
+ @return 0-86399
+ */
+uint32_t SoftClock::secondOfDay()
+{
+    return (uint32_t)((now() % SOFTCLOCK_DAY_US) / SOFTCLOCK_SECOND_US);
+}
+
+/**
+ @brief Current time of day
+ @param [out] time tm_hour, tm_min and tm_sec are filled in
+ @param [in] ahead Seconds to add, e.g. 1 to stage the next second
+ */
+void SoftClock::getTime(struct tm *time, uint32_t ahead)
+{
+    uint32_t second = (secondOfDay() + ahead) % 86400;
+    time->tm_hour = second / 3600;
+    time->tm_min = (second / 60) % 60;
+    time->tm_sec = second % 60;
+}
+
+/**
+ @brief Compares the clock against an RTC second edge. Offsets up to SOFTCLOCK_STEP_US are slewed out at
+        SOFTCLOCK_MAX_SLEW_PPM and also trim the frequency correction, larger ones and the first call step the clock
+ @param [in] second Second of the day the RTC ticked over to
+ @param [in] edge esp_timer_get_time() at that tick, no more than a few seconds ago
+ @note Call it about once a minute, away from the second edge. The RTC is then only the holdover reference
+ */
+void SoftClock::discipline(uint32_t second, int64_t edge)
+{
+    bool step;
+    portENTER_CRITICAL(&_mux);
+    int64_t mono = esp_timer_get_time();
+    rebaseInternal(mono);
+    int64_t rtc = second * SOFTCLOCK_SECOND_US + (mono - edge);
+    int64_t offset = (rtc - _refTime) % SOFTCLOCK_DAY_US;
+    if (offset >= SOFTCLOCK_DAY_US / 2)
+    {
+        offset -= SOFTCLOCK_DAY_US;
+    }
+    else if (offset < -SOFTCLOCK_DAY_US / 2)
+    {
+        offset += SOFTCLOCK_DAY_US;
+    }
+    step = !_set || offset > SOFTCLOCK_STEP_US || offset < -SOFTCLOCK_STEP_US;
+    if (step)
+    {
+        _refTime = rtc;
+        _slew = 0;
+        _set = true;
+    }
+    else
+    {
+        if (_lastEdge != 0 && edge - _lastEdge > 0)
+        {
+            // the part of the offset that the pending slew does not cover has built up since the last edge
+            int64_t freq = _freq + (offset - _slew) * 1000000000LL / (edge - _lastEdge) / 2;
+            _freq = (int32_t)(freq > SOFTCLOCK_MAX_FREQ_PPB ? SOFTCLOCK_MAX_FREQ_PPB : freq < -SOFTCLOCK_MAX_FREQ_PPB ? -SOFTCLOCK_MAX_FREQ_PPB : freq);
+        }
+        _slew = offset;
+    }
+    _lastEdge = edge;
+    _offset = (int32_t)offset;
+    portEXIT_CRITICAL(&_mux);
+    if (step && _timer != NULL)
+    {
+        // the second edges move with the step
+        esp_timer_stop(_timer);
+        armInternal();
+    }
+}
+
+/**
+ @brief Offset of the RTC from the clock at the last discipline()
+ @return Offset in us, positive if the clock was behind
+ */
+int32_t SoftClock::getOffset()
+{
+    return _offset;
+}
+
+/**
+ @brief Frequency correction learnt from the RTC
+ @return Correction in ppb, positive if esp_timer runs slow
+ */
+int32_t SoftClock::getFrequency()
+{
+    return _freq;
+}
+
+/**
+ @brief Internal function to get the clock time at an esp_timer time at or after _ref
+ @param [in] mono esp_timer_get_time() to get the clock time at
+ @param [out] slewed Part of _slew applied up to mono, may be NULL
+ @return Clock time in us
+ */
+int64_t SoftClock::atInternal(int64_t mono, int64_t *slewed)
+{
+    int64_t dt = mono - _ref;
+    int64_t max = dt * SOFTCLOCK_MAX_SLEW_PPM / 1000000;
+    int64_t slew = _slew > max ? max : _slew < -max ? -max : _slew;
+    if (slewed != NULL)
+    {
+        *slewed = slew;
+    }
+    return _refTime + dt + dt * _freq / 1000000000LL + slew;
+}
+
+/**
+ @brief Internal function to move the reference point of the clock up to an esp_timer time
+ @param [in] mono esp_timer_get_time() to move the reference to
+ */
+void SoftClock::rebaseInternal(int64_t mono)
+{
+    int64_t slewed;
+    _refTime = atInternal(mono, &slewed);
+    _slew -= slewed;
+    _ref = mono;
+}
+
+/**
+ @brief Internal function to start the timer for the next second edge of the clock
+ @note The delay is in clock time, off by at most the frequency correction plus slew rate. An early timer is re-armed
+ */
+void SoftClock::armInternal()
+{
+    int64_t into = now() % SOFTCLOCK_SECOND_US;
+    esp_timer_start_once(_timer, SOFTCLOCK_SECOND_US - into);
+}
+
+/**
+ @brief Internal esp_timer callback at a second edge, notifies the task and re-arms for the next edge
+ @param [in] arg SoftClock that started the timer
+ */
+void SoftClock::onTimerInternal(void *arg)
+{
+    SoftClock *clock = (SoftClock *)arg;
+    portENTER_CRITICAL(&clock->_mux);
+    clock->rebaseInternal(esp_timer_get_time());
+    int64_t into = clock->_refTime % SOFTCLOCK_SECOND_US;
+    portEXIT_CRITICAL(&clock->_mux);
+    if (into < SOFTCLOCK_SECOND_US / 2 && clock->_task != NULL)
+    {
+        xTaskNotifyGive(clock->_task);
+    }
+    esp_timer_start_once(clock->_timer, SOFTCLOCK_SECOND_US - into);
+}
@@ -0,0 +1,54 @@
+/**
+ @file softclock.h
+ @brief Software clock on esp_timer, disciplined against the second edges of an RTC
+ @author Edward62740
+ */
+
+#ifndef SOFTCLOCK_H
+#define SOFTCLOCK_H
+
+#include <Arduino.h>
+#include <time.h>
+#include <esp_timer.h>
+
+#define SOFTCLOCK_SECOND_US 1000000LL
+#define SOFTCLOCK_DAY_US (86400LL * SOFTCLOCK_SECOND_US)
+#define SOFTCLOCK_STEP_US 128000 // offsets larger than this are stepped, smaller ones are slewed
+#define SOFTCLOCK_MAX_SLEW_PPM 500 // slew rate, 128ms takes about 4min to slew out
+#define SOFTCLOCK_MAX_FREQ_PPB 200000 // limit of the frequency correction
+
+/**
+ @class SoftClock
+ @brief Time of day kept from esp_timer_get_time() with a frequency correction and a slew, so it never steps for small
+        corrections. Emits its own second edges to a task, and only needs an RTC reading now and then
+ */
+class SoftClock
+{
+    public:
+    SoftClock();
+    bool begin(TaskHandle_t task);
+    bool isSet();
+    int64_t now();
+    uint32_t secondOfDay();
+    void getTime(struct tm *time, uint32_t ahead = 0);
+    void discipline(uint32_t second, int64_t edge);
+    int32_t getOffset();
+    int32_t getFrequency();
+    private:
+    portMUX_TYPE _mux;
+    esp_timer_handle_t _timer;
+    TaskHandle_t _task;
+    bool _set; // false until the first discipline() has stepped the clock
+    int64_t _ref; // esp_timer_get_time() at which the clock read _refTime
+    int64_t _refTime; // clock time at _ref in us, only ever compared modulo a day
+    int64_t _slew; // correction still to be slewed in, in us
+    int32_t _freq; // frequency correction in ppb
+    int64_t _lastEdge; // edge of the last discipline(), 0 if none
+    int32_t _offset; // offset measured by the last discipline() in us
+    int64_t atInternal(int64_t mono, int64_t *slewed);
+    void rebaseInternal(int64_t mono);
+    void armInternal();
+    static void onTimerInternal(void *arg);
+};
+
+#endif
@@ -139,93 +139,63 @@ int year(time_t t) { // the year for the given time
 /* functions to convert to and from system time */
 /* These are for interfacing with time services and are not normally needed in a sketch */
 
-// leap year calculator expects year argument as years offset from 1970
-#define LEAP_YEAR(Y)     ( ((1970+(Y))>0) && !((1970+(Y))%4) && ( ((1970+(Y))%100) || !((1970+(Y))%400) ) )
+// Constant time conversions between days since 1970 and civil dates, from Howard Hinnant's
+// chrono-compatible low-level date algorithms (http://howardhinnant.github.io/date_algorithms.html).
+// The year is shifted to start in March, so the leap day is the last day of the year and the
+// month lengths from March on follow (153 * month + 2) / 5. Eras are 400 year cycles of 146097 days.
+
+// days since Jan 1 1970 of the given date, months and days start from 1
+static int32_t daysFromCivil(int32_t year, uint8_t month, uint8_t day) {
+  year -= month <= 2;
+  const int32_t era = (year >= 0 ? year : year - 399) / 400;
+  const uint32_t yoe = (uint32_t)(year - era * 400);                               // [0, 399]
+  const uint32_t doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1; // [0, 365]
+  const uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;                      // [0, 146096]
+  return era * 146097 + (int32_t)doe - 719468;
+}
 
-static  const uint8_t monthDays[]={31,28,31,30,31,30,31,31,30,31,30,31}; // API starts months from 1, this array starts from 0
+// date of the given days since Jan 1 1970, months and days start from 1
+static void civilFromDays(int32_t days, int32_t &year, uint8_t &month, uint8_t &day) {
+  days += 719468;
+  const int32_t era = (days >= 0 ? days : days - 146096) / 146097;
+  const uint32_t doe = (uint32_t)(days - era * 146097);                     // [0, 146096]
+  const uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365; // [0, 399]
+  const uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);               // [0, 365]
+  const uint32_t mp = (5 * doy + 2) / 153;                                    // [0, 11], March is 0
+  day = doy - (153 * mp + 2) / 5 + 1;
+  month = mp < 10 ? mp + 3 : mp - 9;
+  year = (int32_t)yoe + era * 400 + (month <= 2);
+}
  
 void breakTime(time_t timeInput, tmElements_t &tm){
 // break the given time_t into time components
 // this is a more compact version of the C library localtime function
 // note that year is offset from 1970 !!!
 
-  uint8_t year;
-  uint8_t month, monthLength;
-  uint32_t time;
-  unsigned long days;
+  // a 64 bit time_t is only divided once, the rest fits in 32 bits
+  uint32_t days = (uint32_t)((uint64_t)timeInput / SECS_PER_DAY);
+  uint32_t time = (uint32_t)((uint64_t)timeInput - (uint64_t)days * SECS_PER_DAY);
+  int32_t year;
 
-  time = (uint32_t)timeInput;
   tm.Second = time % 60;
   time /= 60; // now it is minutes
   tm.Minute = time % 60;
   time /= 60; // now it is hours
-  tm.Hour = time % 24;
-  time /= 24; // now it is days
-  tm.Wday = ((time + 4) % 7) + 1;  // Sunday is day 1 
-  
-  year = 0;  
-  days = 0;
-  while((unsigned)(days += (LEAP_YEAR(year) ? 366 : 365)) <= time) {
-    year++;
-  }
-  tm.Year = year; // year is offset from 1970 
-  
-  days -= LEAP_YEAR(year) ? 366 : 365;
-  time  -= days; // now it is days in this year, starting at 0
-  
-  days=0;
-  month=0;
-  monthLength=0;
-  for (month=0; month<12; month++) {
-    if (month==1) { // february
-      if (LEAP_YEAR(year)) {
-        monthLength=29;
-      } else {
-        monthLength=28;
-      }
-    } else {
-      monthLength = monthDays[month];
-    }
-    
-    if (time >= monthLength) {
-      time -= monthLength;
-    } else {
-        break;
-    }
-  }
-  tm.Month = month + 1;  // jan is month 1  
-  tm.Day = time + 1;     // day of month
+  tm.Hour = time;
+  tm.Wday = ((days + 4) % 7) + 1;  // Sunday is day 1
+
+  civilFromDays((int32_t)days, year, tm.Month, tm.Day);
+  tm.Year = CalendarYrToTm(year); // year is offset from 1970
 }
 
 time_t makeTime(const tmElements_t &tm){   
 // assemble time elements into time_t 
 // note year argument is offset from 1970 (see macros in time.h to convert to other formats)
 // previous version used full four digit year (or digits since 2000),i.e. 2009 was 2009 or 9
-  
-  int i;
-  uint32_t seconds;
-
-  // seconds from 1970 till 1 jan 00:00:00 of the given year
-  seconds= tm.Year*(SECS_PER_DAY * 365);
-  for (i = 0; i < tm.Year; i++) {
-    if (LEAP_YEAR(i)) {
-      seconds += SECS_PER_DAY;   // add extra days for leap years
-    }
-  }
-  
-  // add days for this year, months start from 1
-  for (i = 1; i < tm.Month; i++) {
-    if ( (i == 2) && LEAP_YEAR(tm.Year)) { 
-      seconds += SECS_PER_DAY * 29;
-    } else {
-      seconds += SECS_PER_DAY * monthDays[i-1];  //monthDay array starts from 0
-    }
-  }
-  seconds+= (tm.Day-1) * SECS_PER_DAY;
-  seconds+= tm.Hour * SECS_PER_HOUR;
-  seconds+= tm.Minute * SECS_PER_MIN;
-  seconds+= tm.Second;
-  return (time_t)seconds; 
+
+  // 64 bit math, so a 64 bit time_t goes past 2038 and 2106
+  uint64_t days = (uint64_t)daysFromCivil(tmYearToCalendar(tm.Year), tm.Month, tm.Day);
+  return (time_t)(days * SECS_PER_DAY + tm.Hour * SECS_PER_HOUR + tm.Minute * SECS_PER_MIN + tm.Second);
 }
 /*=====================================================*/	
 /* Low level system time functions  */
@@ -236,6 +206,8 @@ static uint32_t nextSyncTime = 0;
 static timeStatus_t Status = timeNotSet;
 
 getExternalTime getTimePtr;  // pointer to external sync function
+requestExternalTime requestTimePtr; // pointer to external function that starts an asynchronous sync
+static bool syncPending = false; // requestTimePtr was called and syncTime() has not answered yet
 //setExternalTime setTimePtr; // not used in this version
 
 #ifdef TIME_DRIFT_INFO   // define this to get drift data
@@ -245,16 +217,27 @@ time_t sysUnsyncedTime = 0; // the time sysTime unadjusted by sync
 
 time_t now() {
 	// calculate number of seconds passed since last call to now()
-  while (millis() - prevMillis >= 1000) {
-		// millis() and prevMillis are both unsigned ints thus the subtraction will always be the absolute value of the difference
-    sysTime++;
-    prevMillis += 1000;	
+  // millis() and prevMillis are both unsigned ints thus the subtraction will always be the absolute value of the difference
+  uint32_t elapsed = millis() - prevMillis;
+  if (elapsed >= 1000) {
+    // one division however long the caller was stalled, prevMillis keeps the part of a second left over
+    uint32_t seconds = elapsed / 1000;
+    sysTime += seconds;
+    prevMillis += seconds * 1000;
 #ifdef TIME_DRIFT_INFO
-    sysUnsyncedTime++; // this can be compared to the synced time to measure long term drift     
+    sysUnsyncedTime += seconds; // this can be compared to the synced time to measure long term drift
 #endif
   }
   if (nextSyncTime <= sysTime) {
-    if (getTimePtr != 0) {
+    if (requestTimePtr != 0) {
+      // the provider only starts the sync, an unanswered one is retried after the sync interval
+      nextSyncTime = sysTime + syncInterval;
+      if (syncPending) {
+        Status = (Status == timeNotSet) ?  timeNotSet : timeNeedsSync;
+      }
+      syncPending = true;
+      requestTimePtr();
+    } else if (getTimePtr != 0) {
       time_t t = getTimePtr();
       if (t != 0) {
         setTime(t);
@@ -295,6 +278,17 @@ void setTime(int hr,int min,int sec,int dy, int mnth, int yr){
   setTime(makeTime(tm));
 }
 
+void syncTime(time_t t, uint16_t ms) {
+  // call from the task that calls now(), e.g. where the provider's replies are polled
+  syncPending = false;
+  if (t != 0) {
+    setTime(t);
+    prevMillis -= ms; // the second started ms ago
+  } else {
+    Status = (Status == timeNotSet) ?  timeNotSet : timeNeedsSync;
+  }
+}
+
 void adjustTime(long adjustment) {
   sysTime += adjustment;
 }
@@ -311,6 +305,13 @@ void setSyncProvider( getExternalTime getTimeFunction){
   now(); // this will sync the clock
 }
 
+void setAsyncSyncProvider( requestExternalTime requestTimeFunction){
+  requestTimePtr = requestTimeFunction;
+  syncPending = false;
+  nextSyncTime = sysTime;
+  now(); // this will start a sync
+}
+
 void setSyncInterval(time_t interval){ // set the number of seconds between re-sync
   syncInterval = (uint32_t)interval;
   nextSyncTime = sysTime + syncInterval;
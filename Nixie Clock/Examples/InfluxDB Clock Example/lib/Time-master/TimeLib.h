@@ -59,6 +59,7 @@ typedef struct  {
 #define  y2kYearToTm(Y)      ((Y) + 30)   
 
 typedef time_t(*getExternalTime)();
+typedef void(*requestExternalTime)(); // starts a sync and returns at once, the time is handed back with syncTime()
 //typedef void  (*setExternalTime)(const time_t); // not used in this version
 
 
@@ -132,6 +133,8 @@ char* dayShortStr(uint8_t day);
 /* time sync functions	*/
 timeStatus_t timeStatus(); // indicates if time has been set and recently synchronized
 void    setSyncProvider( getExternalTime getTimeFunction); // identify the external time provider
+void    setAsyncSyncProvider( requestExternalTime requestTimeFunction); // external time provider that never blocks now()
+void    syncTime(time_t t, uint16_t ms = 0); // completes a sync started by the async provider, t = 0 if it failed
 void    setSyncInterval(time_t interval); // set the number of seconds between re-sync
 
 /* low level functions to convert to and from system time                     */
@@ -0,0 +1,14 @@
+/*
+  Arduino.h - Minimal host shim so Time.cpp builds for the host benchmark
+*/
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+//Defined by the example
+unsigned long millis();
+
+#endif
@@ -0,0 +1,244 @@
+/*
+  host_benchmark.cpp - Checks breakTime() and makeTime() against the year by year loops they replaced,
+  for every day from 1970 to 2100, and times both. Then times now() after long stalls and runs an
+  asynchronous sync through it.
+  Build and run from this folder:
+    g++ -O2 -I. -I../.. host_benchmark.cpp ../../Time.cpp -o host_benchmark && ./host_benchmark
+*/
+
+#include <stdio.h>
+#include <time.h>
+#include "TimeLib.h"
+
+#define FIRST_YEAR 1970
+#define LAST_YEAR 2100
+#define REPEATS 20
+
+static unsigned long virtualMillis = 0;
+
+unsigned long millis()
+{
+  return virtualMillis;
+}
+
+// The loops of the previous version, kept to check against
+#define LEAP_YEAR(Y)     ( ((1970+(Y))>0) && !((1970+(Y))%4) && ( ((1970+(Y))%100) || !((1970+(Y))%400) ) )
+static const uint8_t monthDays[]={31,28,31,30,31,30,31,31,30,31,30,31};
+
+static void legacyBreakTime(time_t timeInput, tmElements_t &tm)
+{
+  uint8_t year;
+  uint8_t month, monthLength;
+  uint32_t time;
+  unsigned long days;
+
+  time = (uint32_t)timeInput;
+  tm.Second = time % 60;
+  time /= 60;
+  tm.Minute = time % 60;
+  time /= 60;
+  tm.Hour = time % 24;
+  time /= 24;
+  tm.Wday = ((time + 4) % 7) + 1;
+  year = 0;
+  days = 0;
+  while((unsigned)(days += (LEAP_YEAR(year) ? 366 : 365)) <= time) {
+    year++;
+  }
+  tm.Year = year;
+  days -= LEAP_YEAR(year) ? 366 : 365;
+  time  -= days;
+  for (month=0; month<12; month++) {
+    if (month==1) {
+      monthLength = LEAP_YEAR(year) ? 29 : 28;
+    } else {
+      monthLength = monthDays[month];
+    }
+    if (time >= monthLength) {
+      time -= monthLength;
+    } else {
+      break;
+    }
+  }
+  tm.Month = month + 1;
+  tm.Day = time + 1;
+}
+
+static time_t legacyMakeTime(const tmElements_t &tm)
+{
+  int i;
+  uint32_t seconds;
+
+  seconds= tm.Year*(SECS_PER_DAY * 365);
+  for (i = 0; i < tm.Year; i++) {
+    if (LEAP_YEAR(i)) {
+      seconds += SECS_PER_DAY;
+    }
+  }
+  for (i = 1; i < tm.Month; i++) {
+    if ( (i == 2) && LEAP_YEAR(tm.Year)) {
+      seconds += SECS_PER_DAY * 29;
+    } else {
+      seconds += SECS_PER_DAY * monthDays[i-1];
+    }
+  }
+  seconds+= (tm.Day-1) * SECS_PER_DAY;
+  seconds+= tm.Hour * SECS_PER_HOUR;
+  seconds+= tm.Minute * SECS_PER_MIN;
+  seconds+= tm.Second;
+  return (time_t)seconds;
+}
+
+// The catch-up loop of the previous now(), one pass per second missed
+static uint32_t legacySysTime = 0;
+static uint32_t legacyPrevMillis = 0;
+
+static time_t legacyNow()
+{
+  while (millis() - legacyPrevMillis >= 1000) {
+    legacySysTime++;
+    legacyPrevMillis += 1000;
+  }
+  return (time_t)legacySysTime;
+}
+
+// Asynchronous provider, only counts the requests, the reply is handed back by main()
+static uint32_t requests = 0;
+
+static void requestTime()
+{
+  requests++;
+}
+
+static bool sameElements(const tmElements_t &a, const tmElements_t &b)
+{
+  return a.Second == b.Second && a.Minute == b.Minute && a.Hour == b.Hour && a.Wday == b.Wday &&
+         a.Day == b.Day && a.Month == b.Month && a.Year == b.Year;
+}
+
+static double nowNs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// A time of day that moves with the day, so every field changes
+static time_t timeOfDay(uint32_t day)
+{
+  return (time_t)day * SECS_PER_DAY + (day * 7919UL) % SECS_PER_DAY;
+}
+
+static uint32_t check(uint32_t days)
+{
+  uint32_t mismatches = 0;
+  for (uint32_t day = 0; day < days; day++) {
+    time_t t = timeOfDay(day);
+    tmElements_t legacy, fast;
+    legacyBreakTime(t, legacy);
+    breakTime(t, fast);
+    if (!sameElements(legacy, fast) || makeTime(fast) != t || legacyMakeTime(legacy) != t) {
+      mismatches++;
+    }
+  }
+  return mismatches;
+}
+
+// Time per call of the old and new functions over the days of one year
+static void bench(int year)
+{
+  tmElements_t tm;
+  tm.Year = CalendarYrToTm(year);
+  tm.Month = 1;
+  tm.Day = 1;
+  tm.Hour = tm.Minute = tm.Second = 0;
+  uint32_t first = makeTime(tm) / SECS_PER_DAY;
+  volatile uint32_t sink = 0;
+  double ns[4];
+  for (int f = 0; f < 4; f++) {
+    double start = nowNs();
+    for (int r = 0; r < REPEATS; r++) {
+      for (uint32_t day = first; day < first + 365; day++) {
+        time_t t = timeOfDay(day);
+        if (f < 2) {
+          (f == 0 ? legacyBreakTime : breakTime)(t, tm);
+          sink += tm.Day;
+        }
+        else {
+          breakTime(t, tm);
+          sink += (uint32_t)(f == 2 ? legacyMakeTime(tm) : makeTime(tm));
+        }
+      }
+    }
+    ns[f] = (nowNs() - start) / (REPEATS * 365);
+  }
+  // the makeTime() rows include a breakTime() to get the elements
+  printf("%d  breakTime %6.1f -> %5.1f ns   makeTime %6.1f -> %5.1f ns\n", year, ns[0], ns[1], ns[2] - ns[1], ns[3] - ns[1]);
+}
+
+int main()
+{
+  tmElements_t tm;
+  tm.Year = CalendarYrToTm(LAST_YEAR + 1);
+  tm.Month = 1;
+  tm.Day = 1;
+  tm.Hour = tm.Minute = tm.Second = 0;
+  uint32_t days = makeTime(tm) / SECS_PER_DAY;
+  printf("%u days %d-%d, %u breakTime/makeTime mismatches against the loops\n", (unsigned)days, FIRST_YEAR, LAST_YEAR, (unsigned)check(days));
+
+  // past 2106 only a 64 bit time_t holds the time, the loops wrap at 32 bits
+  if (sizeof(time_t) == 8) {
+    uint32_t wrong = 0;
+    for (uint32_t day = days; day < 93502; day++) { // up to the end of 2225, the last year tmElements_t holds
+      tmElements_t fast;
+      breakTime(timeOfDay(day), fast);
+      if (makeTime(fast) != timeOfDay(day)) {
+        wrong++;
+      }
+    }
+    breakTime((time_t)4294967296ULL, tm); // 2106-02-07 06:28:16
+    printf("round trips %d-2225 with a 64 bit time_t: %u wrong, 2^32 s breaks to %d-%02d-%02d %02d:%02d:%02d\n", LAST_YEAR + 1,
+           (unsigned)wrong, tmYearToCalendar(tm.Year), tm.Month, tm.Day, tm.Hour, tm.Minute, tm.Second);
+  }
+
+  for (int year = FIRST_YEAR; year <= LAST_YEAR; year += 26) {
+    bench(year);
+  }
+
+  // now() after stalls of 1s to 11 days, both clocks started together with 0.5s left over
+  setTime(0);
+  virtualMillis = 500;
+  now();
+  legacyNow();
+  uint32_t wrong = 0;
+  for (unsigned long stall = 1000; stall <= 1000000000UL; stall *= 10) {
+    virtualMillis += stall;
+    double start = nowNs();
+    time_t legacy = legacyNow();
+    double legacyNs = nowNs() - start;
+    start = nowNs();
+    time_t fast = now();
+    double fastNs = nowNs() - start;
+    wrong += fast != legacy;
+    printf("now() after a %10lu ms stall  %10.0f -> %4.0f ns\n", stall, legacyNs, fastNs);
+  }
+  printf("%u stalls where now() disagreed with the loop\n", (unsigned)wrong);
+
+  // the request goes out from now(), the reply 1.2s later says it was 250ms into second 1700000000 when it arrived
+  uint32_t sent = requests;
+  setSyncInterval(60);
+  setAsyncSyncProvider(requestTime);
+  virtualMillis += 1200;
+  now();
+  syncTime(1700000000, 250);
+  virtualMillis += 750;
+  time_t synced = now();
+  virtualMillis += 60000; // no reply to the next request
+  now();
+  timeStatus_t pending = timeStatus();
+  virtualMillis += 60000;
+  now();
+  printf("async sync: %u requests, %ld after 750ms, status %d while pending, %d after a missed reply\n", (unsigned)(requests - sent),
+         (long)(synced - 1700000000), (int)pending, (int)timeStatus());
+  return 0;
+}
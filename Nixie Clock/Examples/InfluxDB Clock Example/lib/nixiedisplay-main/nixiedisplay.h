@@ -7,27 +7,210 @@
 #ifndef NIXIEDISPLAY_H
 #define NIXIEDISPLAY_H
 
-#include <Arduino.h>
-#include <Wire.h>
-#include "time.h"
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "nixieplatform.h"
+#include "nixiesequence.h"
 
 
 #define CROSSFADE_PULSE_CYCLE_MS 20
+#define CROSSFADE_PULSE_STEPS 7
 #define SCROLLBACK_INTER_MS 25
+#define PROTECTION_WINDOW_PERIOD_MS 1000 // background protection repeats its window every second after the last digit change
+#define PROTECTION_WINDOW_START_MS 200 // first ms of the window, after the crossfade of the new digits
+#define PROTECTION_WINDOW_END_MS 800 // the written digits are back on the tubes from here until the next second edge
+#define PROTECTION_MIN_DUTY_PERMILLE 1 // weighted protection tops up every cathode to this share of the on-time of its tube
+#define NIXIE_DIGIT_NONE 0xFF
+#define NIXIE_SERVICE_IDLE 0xFFFFFFFF // getServiceDelay() when nothing is running
+#define NIXIE_EXPANDER_PINS 40 // pins 0-39 on the first expander, 40-79 on the second, and so on
+#define NIXIE_EXPANDER_PORTS 5 // 8 bit ports per expander
+#define NIXIE_EXPANDER_COUNT(tubes) (((tubes) * 10 + NIXIE_EXPANDER_PINS - 1) / NIXIE_EXPANDER_PINS) // expanders needed for the cathodes of tubes
+
+typedef enum transition_types
+{
+    TRANSITION_NONE, // tube is showing its target digit
+    TRANSITION_CROSSFADE, // tube is pulsing between the previous and target digit
+    TRANSITION_SCROLLBACK // tube is rolling down from the previous digit to 0
+} nixie_display_transition_t;
+
+/**
+ @brief Location of one cathode on the GPIO expanders
+ */
+typedef struct NixieRoute
+{
+    uint8_t chip; // expander index
+    uint8_t port; // 8 bit port of the expander
+    uint8_t mask; // bit of the cathode in the port
+} nixie_route_t;
+
+/**
+ @brief Cathode locations of N tubes, route[tube][digit]. Build it at compile time with nixieRoutes()
+ */
+template <uint8_t N>
+struct NixieRouteTable
+{
+    nixie_route_t route[N][10];
+};
+
+/**
+ @brief Maps an expander pin to its cathode location
+ @param [in] pin Expander pin, 0-39 on the first expander and 40-79 on the second
+ @return Expander, port and bit of the pin
+ */
+constexpr nixie_route_t nixieRoute(uint8_t pin)
+{
+    return nixie_route_t{(uint8_t)(pin / NIXIE_EXPANDER_PINS), (uint8_t)((pin / 8) % NIXIE_EXPANDER_PORTS), (uint8_t)(1 << (pin % 8))};
+}
+
+constexpr bool nixieRouteEqual(const nixie_route_t &a, const nixie_route_t &b)
+{
+    return a.chip == b.chip && a.port == b.port && a.mask == b.mask;
+}
+
+/**
+ @brief Generates the routing table of a board from its tube pinouts
+ @param [in] pinouts[][] Expander pin of each digit from 0 to 9, one row per tube, leftmost tube first
+ @return Routing table to construct a NixieDisplay with
+ */
+template <uint8_t N>
+constexpr NixieRouteTable<N> nixieRoutes(const uint8_t (&pinouts)[N][10])
+{
+    NixieRouteTable<N> table{};
+    for (uint8_t i = 0; i < N; i++)
+    {
+        for (uint8_t j = 0; j < 10; j++)
+        {
+            table.route[i][j] = nixieRoute(pinouts[i][j]);
+        }
+    }
+    return table;
+}
+
+/**
+ @brief Checks that no two cathodes share an expander pin, for use in a static_assert
+ @param [in] pinouts[][] Tube pinouts as passed to nixieRoutes()
+ @return true if every pin is used once
+ */
+template <uint8_t N>
+constexpr bool nixiePinoutsUnique(const uint8_t (&pinouts)[N][10])
+{
+    for (uint8_t a = 0; a < N * 10; a++)
+    {
+        for (uint8_t b = a + 1; b < N * 10; b++)
+        {
+            if (pinouts[a / 10][a % 10] == pinouts[b / 10][b % 10])
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ @brief Checks that every pin is on one of the NIXIE_EXPANDER_COUNT(N) expanders of the display, for use in a static_assert
+ @param [in] pinouts[][] Tube pinouts as passed to nixieRoutes()
+ @return true if all pins are in range
+ */
+template <uint8_t N>
+constexpr bool nixiePinoutsInRange(const uint8_t (&pinouts)[N][10])
+{
+    for (uint8_t a = 0; a < N * 10; a++)
+    {
+        if (pinouts[a / 10][a % 10] >= NIXIE_EXPANDER_PINS * NIXIE_EXPANDER_COUNT(N))
+        {
+            return false;
+        }
+    }
+    return true;
+}
 
 typedef struct TubeStruct
 {
-    uint8_t pinout[10];
+    nixie_route_t route[10]; // cathode of each digit
     uint8_t index;
+    uint8_t current; // target digit
+    uint8_t prev; // digit being transitioned away from
+    uint8_t lit; // digit currently driven on the tube, NIXIE_DIGIT_NONE if blank
+    nixie_display_transition_t transition;
+    uint32_t start; // NixiePlatform::millis() at the start of the transition
+    uint8_t committed; // digit on the expanders since the last commit, NIXIE_DIGIT_NONE if blank
+    uint64_t usage[10]; // total on-time of each cathode in ms
+    uint32_t recent[10]; // on-time of each cathode in ms since the last weighted protection plan
+    uint16_t plan[10]; // weighted protection frames left for each cathode
 } TubeStruct_t;
 
+typedef enum protection_types
+{
+	CATHODE_PROTECTION_STYLE_WAVE, // drives 0123456789 through the tubes in order, wrapping over at the end
+	CATHODE_PROTECTION_STYLE_SLOT, // cycles through 0-9 for all the tubes
+	CATHODE_PROTECTION_STYLE_SEQUENTIAL, // cycles through all digits based on physical position (for IN-14 tubes)
+	CATHODE_PROTECTION_STYLE_WEIGHTED // lights only under-used cathodes, each for a time proportional to its on-time deficit
+} nixie_display_protection_t;
+
+typedef struct PlayerStruct
+{
+    nixie_display_protection_t type; // protection effect, CATHODE_PROTECTION_STYLE_WEIGHTED frames come from the planner
+    const nixie_frame_t *sequence; // frames being played
+    uint16_t length; // frames in the sequence
+    uint16_t step; // next frame of the sequence
+    uint32_t frames; // frames left to show
+    uint32_t inter; // time to show frames with dwell 0 in ms
+    uint32_t next; // NixiePlatform::millis() at which the next frame is due
+    bool active; // a sequence or protection run is playing
+    bool protection; // the run is a cathode protection run
+    bool windowed; // only show frames between PROTECTION_WINDOW_START_MS and PROTECTION_WINDOW_END_MS
+    bool shown; // a frame is on the tubes instead of the written digits
+} PlayerStruct_t;
+
+template <uint8_t N>
 struct DisplayStruct
 {
-    TubeStruct_t tube[6];
+    TubeStruct_t tube[N];
+    uint8_t digits[N]; // digits of the last written number, tube n shows digits[n + offset]
+    uint8_t prev[N]; // digits of the number written before that
+    uint8_t staged[N]; // digits to be shown by the next commitStaged()
+    bool ready = false; // staged holds digits that have not been committed yet
     uint8_t active;
     uint8_t offset;
     bool crossfade = true;
     bool scrollback = true;
+    uint8_t frame[NIXIE_EXPANDER_COUNT(N)][NIXIE_EXPANDER_PORTS]; // desired cathode bitmap
+    uint8_t committed[NIXIE_EXPANDER_COUNT(N)][NIXIE_EXPANDER_PORTS]; // cathode bitmap last written to the expanders
+    bool synced = false; // false until the first commit has written every port
+    uint32_t written = 0; // NixiePlatform::millis() of the last write that changed a digit
+    uint32_t counted = 0; // NixiePlatform::millis() up to which cathode on-times have been counted
+    PlayerStruct_t player = {};
+};
+
+/**
+ @brief Compile time digit helpers for an N digit number, the recursion is fully unrolled by the compiler
+ */
+template <uint8_t N>
+struct NixieDigits
+{
+    static const uint32_t max = NixieDigits<N - 1>::max * 10 + 9; // largest N digit number
+    static const uint32_t ones = NixieDigits<N - 1>::ones * 10 + 1; // N digit number with every digit 1
+
+    /**
+     @brief Splits num into N digits, most significant first
+     @param [in] num Number to be split, at most max
+     @param [out] digits[] N digits
+     */
+    static inline void split(uint32_t num, uint8_t digits[])
+    {
+        digits[N - 1] = num % 10;
+        NixieDigits<N - 1>::split(num / 10, digits);
+    }
+};
+
+template <>
+struct NixieDigits<0>
+{
+    static const uint32_t max = 0;
+    static const uint32_t ones = 0;
+    static inline void split(uint32_t, uint8_t[]) {}
 };
 
 typedef enum err_codes
@@ -38,32 +221,61 @@ typedef enum err_codes
 	ERR_INT // internal failure
 } nixie_display_err_t;
 
-typedef enum protection_types
-{
-	CATHODE_PROTECTION_STYLE_WAVE, // drives 0123456789 through the tubes in order, wrapping over at the end
-	CATHODE_PROTECTION_STYLE_SLOT, // cycles through 0-9 for all the tubes
-	CATHODE_PROTECTION_STYLE_SEQUENTIAL // cycles through all digits based on physical position (for IN-14 tubes)
-} nixie_display_protection_t;
-
 
-extern bool platformGPIOWrite(uint8_t pin, bool data);
-extern void platformDelayMs(uint32_t ms);
 
+/**
+ @class NixieDisplay
+ @brief Display of N nixie tubes. All state is held in the object, so several displays can run side by side
+ */
+template <uint8_t N>
 class NixieDisplay {
+    static_assert(N >= 1 && N <= 9, "NixieDisplay supports 1 to 9 tubes");
     public:
-    NixieDisplay(uint8_t active, uint8_t offset, 
-    uint8_t pinout1[], uint8_t pinout2[], uint8_t pinout3[], uint8_t pinout4[], uint8_t pinout5[], uint8_t pinout6[]);
+    NixieDisplay(NixiePlatform &platform, uint8_t active, uint8_t offset, const NixieRouteTable<N> &routes);
     ~NixieDisplay(void);
     nixie_display_err_t init();
     nixie_display_err_t write(uint32_t num);
     nixie_display_err_t writeTime(struct tm *time);
     nixie_display_err_t writeSingleTube(uint8_t tube, uint8_t value);
+    nixie_display_err_t stage(uint32_t num);
+    nixie_display_err_t stageTime(struct tm *time);
+    nixie_display_err_t commitStaged();
+    nixie_display_err_t commit();
+    nixie_display_err_t service();
+    nixie_display_err_t flush();
+    uint32_t getServiceDelay();
+    bool isTransitioning();
     nixie_display_err_t clear();
     nixie_display_err_t setCrossfade(bool crossfade);
     nixie_display_err_t setScrollback(bool scrollback);
     nixie_display_err_t runProtection(nixie_display_protection_t type, uint32_t ms, uint32_t CATHODE_PROTECTION_INTER_MS = 15);
+    nixie_display_err_t startProtection(nixie_display_protection_t type, uint32_t ms, uint32_t CATHODE_PROTECTION_INTER_MS = 15);
+    nixie_display_err_t stopProtection();
+    bool isProtecting();
+    nixie_display_err_t play(const nixie_sequence_t &sequence, uint32_t repeats = 1, uint32_t dwell = 15);
+    nixie_display_err_t stop();
+    bool isPlaying();
+    uint64_t getCathodeUsage(uint8_t tube, uint8_t digit);
+    nixie_display_err_t resetCathodeUsage();
     private:
+    NixiePlatform *_platform;
+    DisplayStruct<N> _display;
+    nixie_display_err_t writeDigitsInternal(bool changed_only);
+    void splitTimeInternal(struct tm *time, uint8_t digits[]);
     nixie_display_err_t writeTubeInternal(uint8_t tube, uint8_t current, uint8_t prev);
+    nixie_display_err_t protectInternal(nixie_display_protection_t type, uint32_t ms, uint32_t inter, bool windowed);
+    void startPlayerInternal(const nixie_frame_t *sequence, uint16_t length, uint32_t frames, uint32_t inter, bool windowed);
+    void servicePlayerInternal(uint32_t now);
+    void sequenceFrameInternal(const nixie_frame_t &frame, uint8_t digits[]);
+    void weightedFrameInternal(uint8_t digits[]);
+    uint32_t planProtectionInternal(uint32_t ms, uint32_t inter);
+    void countUsageInternal();
+    void serviceTubeInternal(uint8_t tube, uint32_t now);
+    void lightTubeInternal(uint8_t tube, uint8_t digit);
+    void setCathodeInternal(const nixie_route_t &route, bool data);
 
 };
-#endif
\ No newline at end of file
+
+#include "nixiedisplay.tpp"
+
+#endif
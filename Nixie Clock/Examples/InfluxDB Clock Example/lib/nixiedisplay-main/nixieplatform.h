@@ -0,0 +1,44 @@
+/**
+ @file nixieplatform.h
+ @brief Platform interface used by NixieDisplay for cathode output and timing
+ @author Edward62740
+ */
+
+#ifndef NIXIEPLATFORM_H
+#define NIXIEPLATFORM_H
+
+#include <stdint.h>
+
+/**
+ @class NixiePlatform
+ @brief GPIO sink and clock/delay source that a NixieDisplay is constructed with
+ */
+class NixiePlatform
+{
+    public:
+    virtual ~NixiePlatform() {}
+
+    /**
+     @brief Writes consecutive 8-bit output ports of a GPIO expander
+     @param [in] chip Expander index, pins 0-39 are on chip 0 and 40-79 on chip 1
+     @param [in] port First port to write
+     @param [in] data Output state of each port, one byte per port
+     @param [in] len Number of ports to write
+     @return true if no error
+     */
+    virtual bool portWrite(uint8_t chip, uint8_t port, const uint8_t *data, uint8_t len) = 0;
+
+    /**
+     @brief Blocks for a number of milliseconds
+     @param [in] ms Time to wait in ms
+     */
+    virtual void delayMs(uint32_t ms) = 0;
+
+    /**
+     @brief Free running millisecond count
+     @return Current time in ms
+     */
+    virtual uint32_t millis() = 0;
+};
+
+#endif
@@ -0,0 +1,117 @@
+/**
+ @file nixieplatform_linux.h
+ @brief Host implementation of NixiePlatform with virtual time and a GPIO trace, for tests and benchmarks
+ @author Edward62740
+ */
+
+#ifndef NIXIEPLATFORM_LINUX_H
+#define NIXIEPLATFORM_LINUX_H
+
+#ifndef ARDUINO
+
+#include <string.h>
+#include <vector>
+#include "nixieplatform.h"
+
+#define NIXIE_LINUX_EXPANDER_COUNT 2
+#define NIXIE_LINUX_EXPANDER_PORTS 5
+
+/**
+ @brief One cathode edge seen by LinuxNixiePlatform
+ */
+typedef struct NixieGpioEvent
+{
+    uint32_t ms; // virtual time of the edge
+    uint8_t pin; // expander pin, 0-79
+    bool data; // new cathode state
+} nixie_gpio_event_t;
+
+/**
+ @class LinuxNixiePlatform
+ @brief Records every cathode edge with its virtual timestamp. delayMs() advances virtual time instantly
+ */
+class LinuxNixiePlatform : public NixiePlatform
+{
+    public:
+    LinuxNixiePlatform() : _now(0), _writes(0)
+    {
+        memset(_ports, 0, sizeof(_ports));
+    }
+
+    bool portWrite(uint8_t chip, uint8_t port, const uint8_t *data, uint8_t len)
+    {
+        if (chip >= NIXIE_LINUX_EXPANDER_COUNT || port + len > NIXIE_LINUX_EXPANDER_PORTS)
+        {
+            return false;
+        }
+        _writes++;
+        for (uint8_t i = 0; i < len; i++)
+        {
+            uint8_t changed = _ports[chip][port + i] ^ data[i];
+            for (uint8_t bit = 0; bit < 8; bit++)
+            {
+                if (changed & (1 << bit))
+                {
+                    nixie_gpio_event_t event;
+                    event.ms = _now;
+                    event.pin = (uint8_t)(chip * NIXIE_LINUX_EXPANDER_PORTS * 8 + (port + i) * 8 + bit);
+                    event.data = (data[i] >> bit) & 1;
+                    _trace.push_back(event);
+                }
+            }
+            _ports[chip][port + i] = data[i];
+        }
+        return true;
+    }
+
+    void delayMs(uint32_t ms)
+    {
+        _now += ms;
+    }
+
+    uint32_t millis()
+    {
+        return _now;
+    }
+
+    /**
+     @brief State of a cathode as last written
+     @param [in] pin Expander pin, 0-79
+     */
+    bool pin(uint8_t pin) const
+    {
+        return (_ports[pin / 40][(pin / 8) % NIXIE_LINUX_EXPANDER_PORTS] >> (pin % 8)) & 1;
+    }
+
+    /**
+     @brief Number of portWrite() calls, i.e. I2C transactions on the real hardware
+     */
+    uint32_t writes() const
+    {
+        return _writes;
+    }
+
+    const std::vector<nixie_gpio_event_t> &trace() const
+    {
+        return _trace;
+    }
+
+    /**
+     @brief Clears the trace and write counter, the port state and virtual time are kept
+     */
+    void reset()
+    {
+        _trace.clear();
+        _writes = 0;
+    }
+
+    private:
+    uint32_t _now;
+    uint32_t _writes;
+    uint8_t _ports[NIXIE_LINUX_EXPANDER_COUNT][NIXIE_LINUX_EXPANDER_PORTS];
+    std::vector<nixie_gpio_event_t> _trace;
+};
+
+#endif // ARDUINO
+
+#endif
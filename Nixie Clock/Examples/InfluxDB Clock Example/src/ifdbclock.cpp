@@ -8,6 +8,9 @@
 #include <WiFi.h>
 #include "time.h"
 #include "nixiedisplay.h"
+#include "softclock.h"
+#include "driftestimator.h"
+#include "nixiemodes.h"
 #include <InfluxDbClient.h>
 #include <InfluxDbCloud.h>
 #include "DFRobot_SHT20.h"
@@ -15,8 +18,10 @@
 void ifdb(void *pvParameters);
 void tubes(void *pvParameters);
 void leds(void *pvParameters);
-bool platformGPIOWrite(uint8_t pin, bool data);
-void platformDelayMs(uint32_t ms);
+void IRAM_ATTR rtcEdge();
+void setRtcFromNtp();
+bool measureRtcOffset(int32_t *offset);
+void trimRtc();
 #ifdef __cplusplus
 extern "C"
 {
@@ -43,10 +48,16 @@ String hostname = "NIXIE TUBE CLOCK";
 /* InfluxDB Data Points */
 Point Clock("Clock");
 
-const char *ntpServer = "";
+const char *ntpServer = "pool.ntp.org";
 const long gmtOffset_sec = 0;
 const int daylightOffset_sec = 0;
 
+/* RTC trimming against NTP */
+#define NTP_SYNC_MIN_MS 3600000UL   // sync interval while the drift is being learnt, 1h
+#define NTP_SYNC_MAX_MS 259200000UL // sync interval once the RTC is trimmed, 3 days
+#define RTC_RESET_MS 250            // RTC offsets past this are set again from NTP
+#define DRIFT_MIN_SPAN_S 21600      // samples have to span 6h before the drift is trusted, 1ppm is 22ms
+
 #define LED_COUNT 6
 /* Pin configuration */
 #define LED1 23
@@ -66,12 +77,25 @@ const int daylightOffset_sec = 0;
 #define UART_BAUDRATE 115200
 #define I2C_CLK_RATE 100000
 
-uint8_t pinout1[10] = {5, 4, 3, 2, 1, 0, 9, 8, 7, 6};
-uint8_t pinout2[10] = {15, 14, 13, 12, 11, 10, 27, 26, 25, 24};
-uint8_t pinout3[10] = {35, 34, 31, 30, 29, 28, 39, 38, 37, 36};
-uint8_t pinout4[10] = {45, 44, 43, 42, 41, 40, 49, 48, 47, 46};
-uint8_t pinout5[10] = {55, 54, 53, 52, 51, 50, 67, 66, 65, 64};
-uint8_t pinout6[10] = {75, 74, 71, 70, 69, 68, 79, 78, 77, 76};
+constexpr uint8_t pinouts[6][10] = {
+  {5, 4, 3, 2, 1, 0, 9, 8, 7, 6},
+  {15, 14, 13, 12, 11, 10, 27, 26, 25, 24},
+  {35, 34, 31, 30, 29, 28, 39, 38, 37, 36},
+  {45, 44, 43, 42, 41, 40, 49, 48, 47, 46},
+  {55, 54, 53, 52, 51, 50, 67, 66, 65, 64},
+  {75, 74, 71, 70, 69, 68, 79, 78, 77, 76}};
+static_assert(nixiePinoutsUnique(pinouts), "two cathodes are routed to the same expander pin");
+static_assert(nixiePinoutsInRange(pinouts), "cathode routed past the last expander");
+constexpr NixieRouteTable<6> routes = nixieRoutes(pinouts); // tube/digit -> expander/port/bit, generated at compile time
+
+/* Nixie tube driver platform */
+class ExpanderPlatform : public NixiePlatform
+{
+public:
+  bool portWrite(uint8_t chip, uint8_t port, const uint8_t *data, uint8_t len);
+  void delayMs(uint32_t ms);
+  uint32_t millis();
+};
 
 /* Objects */
 WS2812FX ws2812fx = WS2812FX(LED_COUNT, LEDADDR, NEO_GRB + NEO_KHZ800);
@@ -80,13 +104,19 @@ PCA9698 gp0(0x20, SDA, SCL, I2C_CLK_RATE); // instantiate PCA9698(I2C address, S
 PCA9698 gp1(0x21, SDA, SCL, I2C_CLK_RATE);
 DFRobot_SHT20 sht20;
 WiFiUDP ntpUDP;
-NTPClient timeClient(ntpUDP);
+NTPClient timeClient(ntpUDP, ntpServer, gmtOffset_sec + daylightOffset_sec);
 InfluxDBClient client(INFLUXDB_URL, INFLUXDB_ORG, INFLUXDB_BUCKET, INFLUXDB_TOKEN, InfluxDbCloud2CACert);
-NixieDisplay display(6, 0, pinout1, pinout2, pinout3, pinout4, pinout5, pinout6);
+ExpanderPlatform nixiePlatform;
+NixieDisplay<6> display(nixiePlatform, 6, 0, routes);
+SoftClock softClock; // drives the display, the RTC is only read once a minute to discipline it
+DriftEstimator rtcDrift; // RTC offsets against NTP since the last set or trim
 
 /* Timer handles */
 TimerHandle_t ifdbTimer;
 
+/* Wire has no lock of its own, the tubes task on core 1 and the ifdb task on core 0 take this around every transaction */
+SemaphoreHandle_t wireMutex;
+
 /* Global variables */
 uint32_t prev_time = 0;
 uint32_t now_time = 0;
@@ -97,19 +127,124 @@ bool is_hour_chime = false;
 bool is_night = false;
 bool is_restrict = true;
 bool is_inactive = false;
+volatile int64_t rtc_edge = 0; // esp_timer_get_time() at the last RTC seconds increment
+uint32_t ntp_sync_interval = NTP_SYNC_MIN_MS;
+uint32_t ntp_last_sync = 0;
 
 struct
 {
   uint32_t IFDB_ERR_COUNT = 0;
   float BOARD_TEMP = 0;
   float BOARD_HUM = 0;
+  int32_t RTC_OFFSET = 0;
+  float RTC_DRIFT = 0;
+  uint8_t RTC_AGING = PCF2129_AGING_OFFSET_ZERO;
 } info;
 
+/* Display modes, the number is the index in modeTable */
+#define MODE_TIME 0
+#define MODE_DATE 1
+#define MODE_SENSOR 2
+
+/* Time of day from the soft clock */
+class TimeMode : public NixieMode
+{
+public:
+  void enter(uint32_t /*second*/)
+  {
+    _set = softClock.isSet();
+  }
+  bool onTick(uint32_t /*second*/)
+  {
+    // frames rendered before the soft clock followed the RTC are stale
+    bool stale = !_set;
+    _set = softClock.isSet();
+    return stale;
+  }
+  uint32_t render(uint32_t ahead)
+  {
+    struct tm time;
+    softClock.getTime(&time, ahead);
+    return time.tm_hour * 10000 + time.tm_min * 100 + time.tm_sec;
+  }
+
+private:
+  bool _set = false;
+};
+
+/* Date from the RTC as DDMMYY */
+class DateMode : public NixieMode
+{
+public:
+  void enter(uint32_t /*second*/)
+  {
+    readDate();
+  }
+  bool onTick(uint32_t second)
+  {
+    // the date turns over at midnight, read it until the RTC has ticked over as well
+    if (second == 0)
+    {
+      _due = true;
+    }
+    if (!_due)
+    {
+      return false;
+    }
+    _due = readDate() == 23;
+    return true;
+  }
+  uint32_t render(uint32_t /*ahead*/)
+  {
+    return _ddmmyy;
+  }
+
+private:
+  uint32_t _ddmmyy = 0;
+  bool _due = false;
+  uint8_t readDate()
+  {
+    xSemaphoreTake(wireMutex, portMAX_DELAY);
+    DateTime rtc = faboRTC.now();
+    xSemaphoreGive(wireMutex);
+    _ddmmyy = rtc.day() * 10000 + rtc.month() * 100 + rtc.year() % 100;
+    return rtc.hour();
+  }
+};
+
+/* Board temperature and humidity in tenths as TTTHHH, e.g. 235482 for 23.5C and 48.2% */
+class SensorMode : public NixieMode
+{
+public:
+  uint32_t render(uint32_t /*ahead*/)
+  {
+    uint32_t temp = constrain(lroundf(info.BOARD_TEMP * 10), 0, 999);
+    uint32_t hum = constrain(lroundf(info.BOARD_HUM * 10), 0, 999);
+    return temp * 1000 + hum;
+  }
+};
+
+TimeMode timeMode;
+DateMode dateMode;
+SensorMode sensorMode;
+NixieMode *const modeTable[] = {&timeMode, &dateMode, &sensorMode};
+NixieModeScheduler modes(modeTable, sizeof(modeTable) / sizeof(modeTable[0]), MODE_TIME);
+
+/* Date at seconds 30-32 and the board temperature and humidity at 33-35 of every 5th minute, the time otherwise */
+const nixie_mode_slot_t modeTimetable[] = {
+    {300, 30, 3, MODE_DATE},
+    {300, 33, 3, MODE_SENSOR}};
+
 void vTimerCallback1(TimerHandle_t ifdbTimer)
 {
   post = true;
 }
 
+void IRAM_ATTR rtcEdge()
+{
+  rtc_edge = esp_timer_get_time();
+}
+
 void setup()
 {
 
@@ -125,6 +260,7 @@ void setup()
   digitalWrite(EN_5, HIGH);
   digitalWrite(nEN_170, LOW);
   delay(50);
+  wireMutex = xSemaphoreCreateMutex();
   Wire.begin(SDA, SCL, (uint32_t)I2C_CLK_RATE);
   delay(250);
   display.init();
@@ -135,27 +271,15 @@ void setup()
   {
     Serial.println("configuring FaBo RTC I2C Brick");
     faboRTC.configure();
+    faboRTC.enableSecondInterrupt();
   }
   Serial.begin(115200);
   Serial.println("[INIT] TEMP SENSOR OK");
 
-  gp0.configuration();     // soft reset and configuration
-  gp0.portMode(0, OUTPUT); // set port directions
-  gp0.portMode(1, OUTPUT);
-  gp0.portMode(2, OUTPUT);
-  gp0.portMode(3, OUTPUT);
-  gp0.portMode(4, OUTPUT);
-  gp1.configuration();     // soft reset and configuration
-  gp1.portMode(0, OUTPUT); // set port directions
-  gp1.portMode(1, OUTPUT);
-  gp1.portMode(2, OUTPUT);
-  gp1.portMode(3, OUTPUT);
-  gp1.portMode(4, OUTPUT);
-  for (int i = 0; i < 40; i++)
-  {
-    gp0.digitalWrite(i, LOW);
-    gp1.digitalWrite(i, LOW);
-  }
+  gp0.configuration(); // all ports as outputs, one burst
+  gp0.setAllClear();
+  gp1.configuration();
+  gp1.setAllClear();
   display.write(0);
   sht20.initSHT20(Wire);
   Serial.println("[INIT] TEMP SENSOR OK");
@@ -196,18 +320,31 @@ void loop()
 
 void tubes(void *pvParameters)
 {
-  DateTime now = faboRTC.now();
   struct tm time;
+  bool staged = false;
+  pinMode(INT_RTC, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(INT_RTC), rtcEdge, FALLING);
+  softClock.begin(xTaskGetCurrentTaskHandle());
+  modes.setTimetable(modeTimetable, sizeof(modeTimetable) / sizeof(modeTimetable[0]));
   while (1)
   {
+    // sleep until the next soft clock second edge, or the next crossfade step or protection frame
+    uint32_t wait = display.getServiceDelay();
+    if (!ulTaskNotifyTake(pdTRUE, wait == NIXIE_SERVICE_IDLE ? portMAX_DELAY : pdMS_TO_TICKS(wait)))
+    {
+      display.service();
+      continue;
+    }
+
+    // second edge, the staged frame goes out in one commit burst with no bus traffic before it
     digitalWrite(23, HIGH);
-    now = faboRTC.now();
-    time.tm_hour = now.hour();
-    time.tm_min = now.minute();
-    time.tm_sec = now.second();
-    Serial.print(time.tm_hour);
-    Serial.print(time.tm_min);
-    Serial.println(time.tm_sec);
+    if (staged)
+    {
+      display.commitStaged();
+    }
+    digitalWrite(23, LOW);
+    softClock.getTime(&time);
+
     if (time.tm_sec == 00 && time.tm_min == 00)
     {
       is_restrict = false;
@@ -217,7 +354,6 @@ void tubes(void *pvParameters)
     {
       is_restrict = true;
     }
-    Serial.println(time.tm_hour);
     if (time.tm_hour > 19 || time.tm_hour < 8)
     {
       is_night = true;
@@ -234,33 +370,48 @@ void tubes(void *pvParameters)
     {
       is_inactive = false;
     }
-    info.BOARD_TEMP = (float)sht20.readTemperature();
-    info.BOARD_HUM = (float)sht20.readHumidity();
-    Serial.println(info.BOARD_TEMP);
-    if (time.tm_hour < 24 && time.tm_min < 60 && time.tm_sec < 60)
+    if ((time.tm_min % 10) != 6 && is_run)
     {
-      display.writeTime(&time);
-      if ((time.tm_min % 10) != 6 && is_run)
-      {
-        is_run = false;
-      }
+      is_run = false;
     }
 
-    digitalWrite(23, LOW);
-
-    if ((time.tm_min % 10) == 6 && !is_run)
+    now_time = time.tm_hour * 10000 + time.tm_min * 100 + time.tm_sec;
+    // a nightly SLOT run still in progress is left to finish, is_run stays clear so this run follows it
+    if ((time.tm_min % 10) == 6 && !is_run && !display.isProtecting())
     {
-      display.runProtection(CATHODE_PROTECTION_STYLE_SEQUENTIAL, 5000);
+      display.startProtection(CATHODE_PROTECTION_STYLE_WEIGHTED, 5000);
       is_run = true;
     }
-    if (now_time == 031500 || now_time == 034500)
+    if ((now_time == 31500 || now_time == 34500) && !display.isProtecting())
     {
-      display.runProtection(CATHODE_PROTECTION_STYLE_SLOT, 120000, 50);
+      display.startProtection(CATHODE_PROTECTION_STYLE_SLOT, 120000, 50);
     }
 
-    vTaskDelay(250);
+    // once a minute, half a second away from the edges, discipline the soft clock against the last RTC edge
+    if (!softClock.isSet() || time.tm_sec == 30)
+    {
+      int64_t edge = rtc_edge;
+      xSemaphoreTake(wireMutex, portMAX_DELAY);
+      DateTime rtc = faboRTC.now();
+      xSemaphoreGive(wireMutex);
+      if (edge != 0 && edge == rtc_edge && esp_timer_get_time() - edge < 1000000 && rtc.second() < 60)
+      {
+        softClock.discipline(rtc.hour() * 3600 + rtc.minute() * 60 + rtc.second(), edge);
+      }
+    }
+
+    // a mode switch by the timetable or a stale frame is written straight away
+    if (modes.tick(softClock.secondOfDay()) || !staged)
+    {
+      display.write(modes.render(0));
+    }
+    // stage the next second so the next edge only costs a commit
+    display.stage(modes.render(1));
+    staged = true;
+    display.service();
   }
 }
+
 void ifdb(void *pvParameters)
 {
   // Connect to Wi-Fi
@@ -275,16 +426,19 @@ void ifdb(void *pvParameters)
     delay(3000);
   }
   delay(500);
-  // Init and get the time
-  configTime(gmtOffset_sec, daylightOffset_sec, ntpServer);
-  struct tm timeinfo;
-  while (!getLocalTime(&timeinfo))
+  // Get the time to the ms and set the RTC on the second edge
+  timeClient.addServer("time.nis.gov");
+  timeClient.addServer("time.google.com");
+  timeClient.begin();
+  while (!timeClient.forceUpdate())
   {
-    configTime(gmtOffset_sec, daylightOffset_sec, ntpServer);
     delay(1000);
   }
-
-  faboRTC.setDate(2021, 5, 12, timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
+  setRtcFromNtp();
+  ntp_last_sync = millis();
+  xSemaphoreTake(wireMutex, portMAX_DELAY);
+  info.RTC_AGING = faboRTC.getAgingOffset();
+  xSemaphoreGive(wireMutex);
   configTzTime("SGT-8", "pool.ntp.org", "time.nis.gov");
   client.setHTTPOptions(HTTPOptions().httpReadTimeout(200));
   client.setHTTPOptions(HTTPOptions().connectionReuse(true));
@@ -311,8 +465,27 @@ void ifdb(void *pvParameters)
       WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
       delay(2000);
     }
+    // NTP rounds run in the background of the posts, each one is a sample for the RTC trim
+    if (millis() - ntp_last_sync >= ntp_sync_interval && timeClient.startUpdate())
+    {
+      ntp_last_sync = millis();
+    }
+    if (timeClient.poll() == NTP_POLL_UPDATED)
+    {
+      trimRtc();
+    }
     if (post)
     {
+      // sampled here for the post, off the display path. A reading holds the bus for up to ~120ms, so it is taken
+      // early in a second and the commit at the next edge is not held up
+      while (softClock.isSet() && softClock.now() % SOFTCLOCK_SECOND_US > 200000)
+      {
+        vTaskDelay(1);
+      }
+      xSemaphoreTake(wireMutex, portMAX_DELAY);
+      info.BOARD_TEMP = (float)sht20.readTemperature();
+      info.BOARD_HUM = (float)sht20.readHumidity();
+      xSemaphoreGive(wireMutex);
 
       Clock.clearFields();
       Clock.clearTags();
@@ -323,6 +496,9 @@ void ifdb(void *pvParameters)
         Clock.addField("Board Hum", info.BOARD_HUM);
       }
       Clock.addField("InfluxDB Error Count", info.IFDB_ERR_COUNT);
+      Clock.addField("RTC Offset", info.RTC_OFFSET);
+      Clock.addField("RTC Drift", info.RTC_DRIFT);
+      Clock.addField("RTC Aging Offset", info.RTC_AGING);
 
       Serial.println(info.BOARD_TEMP);
       Serial.println("POSTED");
@@ -338,6 +514,90 @@ void ifdb(void *pvParameters)
   }
 }
 
+/* Sets the RTC so that it ticks over exactly on an NTP second edge */
+void setRtcFromNtp()
+{
+  uint32_t mono = micros();
+  uint64_t epoch = timeClient.getEpochMillis();
+  // the RTC is written with the next second and released so that it ticks to the one after on its edge, 0.5-1.5s ahead
+  time_t second = epoch / 1000 + 1;
+  uint32_t release = mono + (uint32_t)(((uint64_t)second + 1) * 1000 - epoch) * 1000 - PCF2129_STOP_TO_TICK_US;
+  struct tm date;
+  gmtime_r(&second, &date);
+  // the bus is held until the release, the tubes stall for up to 1.5s, only at boot and when the RTC is far off
+  xSemaphoreTake(wireMutex, portMAX_DELAY);
+  faboRTC.setDate(date.tm_year + 1900, date.tm_mon + 1, date.tm_mday, date.tm_hour, date.tm_min, date.tm_sec, release);
+  xSemaphoreGive(wireMutex);
+}
+
+/* Offset of the RTC from NTP in ms at its last second edge, positive if the RTC is ahead */
+bool measureRtcOffset(int32_t *offset)
+{
+  int64_t edge = rtc_edge;
+  xSemaphoreTake(wireMutex, portMAX_DELAY);
+  DateTime rtc = faboRTC.now();
+  xSemaphoreGive(wireMutex);
+  int64_t mono = esp_timer_get_time();
+  uint64_t ntp = timeClient.getEpochMillis() - (mono - edge) / 1000; // NTP time at the edge
+  if (edge == 0 || edge != rtc_edge || mono - edge >= 1000000 || rtc.second() > 59)
+  {
+    return false;
+  }
+  // only the time of day is compared, the offset is far below half a day
+  int32_t diff = (int32_t)((rtc.hour() * 3600 + rtc.minute() * 60 + rtc.second()) * 1000) - (int32_t)(ntp % 86400000);
+  if (diff > 43200000)
+  {
+    diff -= 86400000;
+  }
+  else if (diff < -43200000)
+  {
+    diff += 86400000;
+  }
+  *offset = diff;
+  return true;
+}
+
+/* Fits the RTC drift over the NTP samples and trims it with the aging offset in 1ppm steps. Syncs back off
+   to NTP_SYNC_MAX_MS once no trim is needed, what is left below a step is taken out by setting the RTC again */
+void trimRtc()
+{
+  int32_t offset;
+  float ppm;
+  if (!measureRtcOffset(&offset))
+  {
+    return;
+  }
+  info.RTC_OFFSET = offset;
+  if (offset > RTC_RESET_MS || offset < -RTC_RESET_MS)
+  {
+    setRtcFromNtp();
+    rtcDrift.reset();
+    return;
+  }
+  rtcDrift.addSample(timeClient.getEpochTime(), offset);
+  if (rtcDrift.getSpan() < DRIFT_MIN_SPAN_S || !rtcDrift.getDrift(&ppm))
+  {
+    return;
+  }
+  info.RTC_DRIFT = ppm;
+  int32_t aging = constrain((int32_t)info.RTC_AGING + (int32_t)lroundf(ppm), 0, 15);
+  if (aging != info.RTC_AGING)
+  {
+    // the slope changes with the trim, the fit starts again from this sample
+    xSemaphoreTake(wireMutex, portMAX_DELAY);
+    faboRTC.setAgingOffset(aging);
+    xSemaphoreGive(wireMutex);
+    info.RTC_AGING = aging;
+    rtcDrift.reset();
+    rtcDrift.addSample(timeClient.getEpochTime(), offset);
+    ntp_sync_interval = NTP_SYNC_MIN_MS;
+  }
+  else
+  {
+    ntp_sync_interval = min(ntp_sync_interval * 2, (uint32_t)NTP_SYNC_MAX_MS);
+  }
+}
+
 void leds(void *pvParameters)
 {
   ws2812fx.init();
@@ -418,27 +678,27 @@ void leds(void *pvParameters)
   }
 }
 
-bool platformGPIOWrite(uint8_t pin, bool data)
+bool ExpanderPlatform::portWrite(uint8_t chip, uint8_t port, const uint8_t *data, uint8_t len)
 {
-
-  if (pin >= 40)
-  {
-    pin = pin - 40;
-    gp1.digitalWrite(pin, data);
-    return true;
-  }
-  else
+  if (chip > 1)
   {
-    gp0.digitalWrite(pin, data);
-    return true;
+    return false;
   }
-
-  return false;
+  // a NACKed write fails the commit, which sends the same span again at the next one
+  xSemaphoreTake(wireMutex, portMAX_DELAY);
+  bool ok = (chip == 0 ? gp0 : gp1).writePorts(port, data, len);
+  xSemaphoreGive(wireMutex);
+  return ok;
 }
 
-void platformDelayMs(uint32_t ms)
+void ExpanderPlatform::delayMs(uint32_t ms)
 {
   digitalWrite(LED2, LOW);
   vTaskDelay(ms);
   digitalWrite(LED2, HIGH);
 }
+
+uint32_t ExpanderPlatform::millis()
+{
+  return ::millis();
+}